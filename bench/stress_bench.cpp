@@ -0,0 +1,343 @@
+/**
+ * Differential stress benchmark. Builds large random, clustered and adversarial
+ * bitvectors, runs access, rank and select through every engine and compares
+ * the answers with a naive packed-word oracle. Reports mismatches and the
+ * throughput of every engine.
+ *
+ * Every engine runs in its own child process, so a crash is reported like a
+ * mismatch instead of ending the whole run.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../src/bitvector.hpp"
+#include "../src/bitvector_collection.hpp"
+#include "../src/paged_bitvector.hpp"
+
+// Input ------------------------------------------------------------------------------------------------------- input
+struct Dataset {
+    std::string name;
+    std::string bits;
+};
+
+std::vector<Dataset> generateDatasets(size_t size, std::mt19937_64& rng) {
+    std::vector<Dataset> datasets;
+    auto random = [&](const std::string& name, double density) {
+        std::bernoulli_distribution coin(density);
+        std::string bits(size, '0');
+        for (auto& c : bits) c = coin(rng) ? '1' : '0';
+        datasets.push_back({name, bits});
+    };
+    random("random", 0.5);
+    random("sparse", 0.01);
+    random("dense", 0.99);
+
+    // Runs of ones and zeros with geometric lengths
+    std::string clustered;
+    std::geometric_distribution<size_t> runLength(1.0 / 300);
+    for (bool bit = false; clustered.size() < size; bit = !bit) {
+        clustered.append(std::min(runLength(rng) + 1, size - clustered.size()), bit ? '1' : '0');
+    }
+    datasets.push_back({"clustered", clustered});
+
+    // Adversarial: extremes, a single far away one, size off the word boundaries
+    datasets.push_back({"zeros+one", std::string(size - 1, '0') + "1"});
+    datasets.push_back({"ones", std::string(size, '1')});
+    std::string alternating(size + 1, '0');
+    for (size_t i = 0; i < alternating.size(); i += 2) alternating[i] = '1';
+    datasets.push_back({"alternating", alternating});
+    std::string boundaries(size - 1, '0');
+    for (size_t i = 63; i < boundaries.size(); i += 512) boundaries[i] = '1';
+    datasets.push_back({"boundaries", boundaries});
+    return datasets;
+}
+
+/**
+ * Naive answers from the packed words, only a prefix count per word
+ */
+struct Oracle {
+    std::vector<uint64_t> words;
+    std::vector<size_t> onesBefore;     //< Ones before each word
+    size_t size;
+
+    explicit Oracle(const std::string& bits) : words(bits.size() / 64 + 1, 0), onesBefore(words.size() + 1, 0), size(bits.size()) {
+        for (size_t i = 0; i < bits.size(); ++i) {
+            if (bits[i] == '1') words[i / 64] |= static_cast<uint64_t>(1) << (i % 64);
+        }
+        for (size_t w = 0; w < words.size(); ++w) {
+            size_t ones = 0;
+            for (size_t j = 0; j < 64; ++j) ones += (words[w] >> j) & 1;
+            onesBefore[w + 1] = onesBefore[w] + ones;
+        }
+    }
+
+    size_t count(bool bit) const {
+        return bit ? onesBefore[words.size()] : size - onesBefore[words.size()];
+    }
+
+    bool access(size_t i) const {
+        return (words[i / 64] >> (i % 64)) & 1;
+    }
+
+    size_t rank(bool bit, size_t i) const {
+        size_t ones = onesBefore[i / 64];
+        for (size_t j = 0; j < i % 64; ++j) ones += (words[i / 64] >> j) & 1;
+        return bit ? ones : i - ones;
+    }
+
+    size_t select(bool bit, size_t n) const {
+        // Last word with less than n bits before it, then bit by bit
+        size_t lo = 0;
+        size_t hi = words.size();
+        while (hi - lo > 1) {
+            size_t mid = lo + (hi - lo) / 2;
+            size_t before = bit ? onesBefore[mid] : mid * 64 - onesBefore[mid];
+            if (before < n) lo = mid;
+            else hi = mid;
+        }
+        size_t seen = bit ? onesBefore[lo] : lo * 64 - onesBefore[lo];
+        for (size_t i = lo * 64; ; ++i) {
+            if (access(i) == bit && ++seen == n) return i;
+        }
+    }
+};
+
+struct Query {
+    bool bit;
+    size_t arg;
+    size_t expected;
+};
+
+struct Workload {
+    std::vector<Query> access;
+    std::vector<Query> rank;
+    std::vector<Query> select;
+};
+
+Workload generateWorkload(const Oracle& oracle, size_t numQueries, bool sorted, std::mt19937_64& rng) {
+    Workload workload;
+    for (size_t k = 0; k < numQueries; ++k) {
+        size_t i = rng() % oracle.size;
+        workload.access.push_back({false, i, oracle.access(i)});
+
+        bool bit = rng() % 2;
+        i = rng() % oracle.size;
+        workload.rank.push_back({bit, i, oracle.rank(bit, i)});
+
+        bit = rng() % 2;
+        if (oracle.count(bit) == 0) bit = !bit;
+        size_t n = 1 + rng() % oracle.count(bit);
+        workload.select.push_back({bit, n, oracle.select(bit, n)});
+    }
+    if (sorted) {
+        auto byArg = [](const Query& a, const Query& b) { return a.arg < b.arg; };
+        std::sort(workload.access.begin(), workload.access.end(), byArg);
+        std::sort(workload.rank.begin(), workload.rank.end(), byArg);
+        std::sort(workload.select.begin(), workload.select.end(), byArg);
+    }
+    return workload;
+}
+
+// Engines ----------------------------------------------------------------------------------------------------- engines
+/**
+ * Every engine answers access, rank and select through the same three methods
+ */
+struct PlainEngine {
+    Bitvector bv;
+    explicit PlainEngine(const std::string& bits) : bv(bits) {}
+    bool access(size_t i) { return bv.access(i); }
+    size_t rank(bool bit, size_t i) { return bv.rank(bit, i); }
+    size_t select(bool bit, size_t n) { return bv.select(bit, n); }
+};
+
+struct CursorEngine {
+    Bitvector bv;
+    Bitvector::Cursor rankCursor;
+    Bitvector::Cursor selectCursors[2];
+    explicit CursorEngine(const std::string& bits) : bv(bits) {}
+    bool access(size_t i) { return bv.access(i); }
+    size_t rank(bool bit, size_t i) { return bv.rank(bit, i, rankCursor); }
+    size_t select(bool bit, size_t n) { return bv.select(bit, n, selectCursors[bit]); }
+};
+
+struct RangeEngine {
+    Bitvector bv;
+    explicit RangeEngine(const std::string& bits) : bv(bits) {}
+    bool access(size_t i) { return bv.countOnes(i, i + 1) == 1; }
+    size_t rank(bool bit, size_t i) { return bit ? bv.countOnes(0, i) : i - bv.countOnes(0, i); }
+    size_t select(bool bit, size_t n) { return bv.selectFrom(bit, 0, n); }
+};
+
+struct CollectionEngine {
+    BitvectorCollection collection;
+    size_t id;
+    explicit CollectionEngine(const std::string& bits) {
+        // Neighbours in the arena, so offsets are not zero
+        collection.add("1011");
+        id = collection.add(bits);
+        collection.add("0");
+    }
+    bool access(size_t i) { return collection.access(id, i); }
+    size_t rank(bool bit, size_t i) { return collection.rank(id, bit, i); }
+    size_t select(bool bit, size_t n) { return collection.select(id, bit, n); }
+};
+
+struct PagedEngine {
+    std::unique_ptr<PagedBitvector> bv;
+    explicit PagedEngine(const std::string& bits) {
+        const char* tmp = getenv("TMPDIR");
+        std::string path = std::string(tmp ? tmp : "/tmp") + "/stress_bench_" + std::to_string(getpid()) + ".bvp";
+        std::istringstream input(bits);
+        if (PagedBitvector::writeFile(input, path)) {
+            // Small pool, so most queries have to page
+            bv = PagedBitvector::open(path, 1 << 10, 16);
+        }
+        std::remove(path.c_str());
+        if (!bv) {
+            fprintf(stderr, "Failed to create paged bitvector %s\n", path.c_str());
+            exit(2);
+        }
+    }
+    bool access(size_t i) { return bv->access(i); }
+    size_t rank(bool bit, size_t i) { return bv->rank(bit, i); }
+    size_t select(bool bit, size_t n) { return bv->select(bit, n); }
+};
+
+// Runner ------------------------------------------------------------------------------------------------------- runner
+struct OpResult {
+    uint64_t queries;
+    uint64_t mismatches;
+    double seconds;
+    Query firstMismatch;
+    uint64_t firstAnswer;
+};
+
+enum Op { ACCESS, RANK, SELECT, NUM_OPS };
+const char* opNames[NUM_OPS] = {"access", "rank", "select"};
+
+template <typename Engine>
+OpResult runOp(Engine& engine, Op op, const std::vector<Query>& queries) {
+    std::vector<size_t> answers(queries.size());
+    auto start = std::chrono::steady_clock::now();
+    for (size_t k = 0; k < queries.size(); ++k) {
+        const Query& q = queries[k];
+        if (op == ACCESS) answers[k] = engine.access(q.arg);
+        else if (op == RANK) answers[k] = engine.rank(q.bit, q.arg);
+        else answers[k] = engine.select(q.bit, q.arg);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    OpResult result{queries.size(), 0, elapsed.count(), {}, 0};
+    for (size_t k = 0; k < queries.size(); ++k) {
+        if (answers[k] != queries[k].expected) {
+            if (result.mismatches++ == 0) {
+                result.firstMismatch = queries[k];
+                result.firstAnswer = answers[k];
+            }
+        }
+    }
+    return result;
+}
+
+/**
+ * Run one op of one engine in a child process
+ * @return Whether the child finished, otherwise it crashed
+ */
+template <typename Engine>
+bool runIsolated(const std::string& bits, Op op, const std::vector<Query>& queries, OpResult& result, int& status) {
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        Engine engine(bits);
+        OpResult res = runOp(engine, op, queries);
+        ssize_t written = write(fds[1], &res, sizeof(res));
+        _exit(written == static_cast<ssize_t>(sizeof(res)) ? 0 : 1);
+    }
+    close(fds[1]);
+    ssize_t got = read(fds[0], &result, sizeof(result));
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+    return got == static_cast<ssize_t>(sizeof(result)) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+struct Totals {
+    size_t mismatches = 0;
+    size_t crashes = 0;
+};
+
+template <typename Engine>
+void runEngine(const char* engineName, const Dataset& dataset, const Workload& workload, Totals& totals) {
+    const std::vector<Query>* queries[NUM_OPS] = {&workload.access, &workload.rank, &workload.select};
+    for (int op = 0; op < NUM_OPS; ++op) {
+        OpResult result{};
+        int status = 0;
+        printf("%-12s %-11s %-7s ", dataset.name.c_str(), engineName, opNames[op]);
+        if (!runIsolated<Engine>(dataset.bits, static_cast<Op>(op), *queries[op], result, status)) {
+            ++totals.crashes;
+            if (WIFSIGNALED(status)) printf("CRASHED (signal %d)\n", WTERMSIG(status));
+            else printf("FAILED (exit %d)\n", WEXITSTATUS(status));
+            continue;
+        }
+        totals.mismatches += result.mismatches;
+        printf("%10.2f Mq/s %10llu mismatches", result.queries / result.seconds / 1e6,
+               static_cast<unsigned long long>(result.mismatches));
+        if (result.mismatches > 0) {
+            printf("  first: %s(%d, %zu) = %llu, expected %zu", opNames[op], result.firstMismatch.bit,
+                   result.firstMismatch.arg, static_cast<unsigned long long>(result.firstAnswer),
+                   result.firstMismatch.expected);
+        }
+        printf("\n");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t size = 1 << 20;
+    size_t numQueries = 200000;
+    uint64_t seed = 1;
+    bool sorted = false;
+    std::string only;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--size" && i + 1 < argc) size = std::stoul(argv[++i]);
+        else if (arg == "--queries" && i + 1 < argc) numQueries = std::stoul(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc) seed = std::stoull(argv[++i]);
+        else if (arg == "--engine" && i + 1 < argc) only = argv[++i];
+        else if (arg == "--sorted") sorted = true;
+        else {
+            fprintf(stderr, "Usage: %s [--size <bits>] [--queries <n>] [--seed <n>] [--engine <name>] [--sorted]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (size < 2) size = 2;
+
+    std::mt19937_64 rng(seed);
+    Totals totals;
+    printf("size=%zu queries=%zu seed=%llu order=%s\n", size, numQueries,
+           static_cast<unsigned long long>(seed), sorted ? "sorted" : "random");
+    for (const Dataset& dataset : generateDatasets(size, rng)) {
+        Oracle oracle(dataset.bits);
+        Workload workload = generateWorkload(oracle, numQueries, sorted, rng);
+
+        if (only.empty() || only == "plain") runEngine<PlainEngine>("plain", dataset, workload, totals);
+        if (only.empty() || only == "cursor") runEngine<CursorEngine>("cursor", dataset, workload, totals);
+        if (only.empty() || only == "range") runEngine<RangeEngine>("range", dataset, workload, totals);
+        if (only.empty() || only == "collection") runEngine<CollectionEngine>("collection", dataset, workload, totals);
+        if (only.empty() || only == "paged") runEngine<PagedEngine>("paged", dataset, workload, totals);
+    }
+
+    printf("total mismatches=%zu crashes=%zu\n", totals.mismatches, totals.crashes);
+    return totals.mismatches == 0 && totals.crashes == 0 ? 0 : 1;
+}
@@ -1,4 +1,5 @@
 #include "bitvector.hpp"
+#include "word_ops.hpp"
 #include <cmath>
 #include <bitset>
 #include <algorithm>
@@ -22,8 +23,7 @@ Bitvector::Bitvector(std::string bits)
   rankLookup(1 << (rankBlockSize-1)),  //< Needs one less bc otherwise we would just look at the block
   selectSBsize(std::max(log2(bits.size()) * log2(bits.size()), 1.0)),
   selectBlockSize(static_cast<size_t>(sqrt(log2(bits.size())))),
-  selectOnesLookup(1 << static_cast<size_t>(log2(bits.size()))),
-  selectZerosLookup(1 << static_cast<size_t>(log2(bits.size()))){
+  selectLookup(std::make_shared<SelectLookup>()) {
     // Fill bitvector uin64 from right to left
     for(size_t i = 0; i < bits.size(); i += 64) {
         uint64_t chunk = 0;
@@ -87,10 +87,6 @@ Bitvector::Bitvector(std::string bits)
     buildSelectStructure(selectOneSBs, '1', bits, k1);
     buildSelectStructure(selectZeroSBs, '0', bits, k0);
 
-    buildSelectLookup(selectOnesLookup, 1);
-    buildSelectLookup(selectZerosLookup, 0);
-
-
 }
 
 /**
@@ -156,6 +152,16 @@ void Bitvector::buildSelectStructure(std::vector<SelectSB> &superblocks, char bi
     }
 }
 
+const Bitvector::SelectLookup& Bitvector::getSelectLookup() {
+    std::call_once(selectLookup->built, [this] {
+        selectLookup->ones.resize(1 << static_cast<size_t>(log2(size)));
+        selectLookup->zeros.resize(1 << static_cast<size_t>(log2(size)));
+        buildSelectLookup(selectLookup->ones, 1);
+        buildSelectLookup(selectLookup->zeros, 0);
+    });
+    return *selectLookup;
+}
+
 void Bitvector::buildSelectLookup(std::vector<std::vector<size_t>>& table, bool bit) {
     for (size_t pattern = 0; pattern < table.size(); ++pattern) {
         table[pattern].resize(selectBlockSize);
@@ -175,6 +181,10 @@ size_t Bitvector::getSize() const {
     return size;
 }
 
+const std::vector<uint64_t>& Bitvector::getWords() const {
+    return bitvector;
+}
+
 bool Bitvector::access(size_t i) {
     uint64_t chunk = bitvector[i/64];
     bool bit = (chunk >> (i%64)) & static_cast<uint64_t>(1);
@@ -246,7 +256,176 @@ size_t Bitvector::rank(bool bit, size_t i) {
     }
 }
 
-size_t Bitvector::selectBits(size_t i, std::vector<SelectSB> &superblocks, std::vector<std::vector<size_t>>& lookupTable, bool bit) {
+size_t Bitvector::onesBeforeWord(size_t word) {
+    if (word == 0) return 0;
+    if (word * 64 < size) return rankOnes(word * 64);
+    // Only the end of the bitvector is not covered by rank
+    return rankOnes((word - 1) * 64) + popcount64(bitvector[word - 1]);
+}
+
+size_t Bitvector::onesBefore(size_t i) {
+    size_t ones = onesBeforeWord(i / 64);
+    if (i % 64 != 0) {
+        ones += popcount64(bitvector[i / 64] & lowerBits(i % 64));
+    }
+    return ones;
+}
+
+void Bitvector::moveCursor(Cursor& cursor, size_t word, size_t ones) const {
+    cursor.word = word;
+    cursor.onesBeforeWord = ones;
+    cursor.superblock = std::min(word * 64 / rankSuperblockSize, rankSuperblocks.size() - 1);
+}
+
+size_t Bitvector::rank(bool bit, size_t i, Cursor& cursor) {
+    size_t word = i / 64;
+    size_t ones = cursor.onesBeforeWord;
+    if (word < cursor.word || word - cursor.word > cursorScanWords) {
+        // Too far away, seek via directories
+        ones = onesBeforeWord(word);
+    } else {
+        for (size_t k = cursor.word; k < word; ++k) {
+            ones += popcount64(bitvector[k]);
+        }
+    }
+    moveCursor(cursor, word, ones);
+
+    if (i % 64 != 0) {
+        ones += popcount64(bitvector[word] & lowerBits(i % 64));
+    }
+    return bit ? ones : i - ones;
+}
+
+size_t Bitvector::select(bool bit, size_t n, Cursor& cursor) {
+    // Number of bits of type bit before a word / superblock / block
+    auto countWord = [&](size_t word, size_t ones) { return bit ? ones : word * 64 - ones; };
+    auto countSB = [&](size_t sb) {
+        return bit ? rankSuperblocks[sb] : sb * rankSuperblockSize - rankSuperblocks[sb];
+    };
+    auto countBlock = [&](size_t sb, size_t block) {
+        size_t ones = rankSuperblocks[sb] + rankBlocks[block];
+        return bit ? ones : block * rankBlockSize - ones;
+    };
+
+    if (countWord(cursor.word, cursor.onesBeforeWord) >= n) {
+        // Moving backwards, start over
+        cursor = Cursor();
+    }
+
+    size_t word = cursor.word;
+    size_t ones = cursor.onesBeforeWord;
+    size_t scanned = 0;
+    while (true) {
+        uint64_t pattern = bit ? bitvector[word] : ~bitvector[word];
+        size_t before = countWord(word, ones);
+        size_t count = popcount64(pattern);
+        if (before + count >= n) {
+            moveCursor(cursor, word, ones);
+            return word * 64 + selectInWord(pattern, n - before - 1);
+        }
+        ones += popcount64(bitvector[word]);
+        ++word;
+
+        if (++scanned == cursorScanWords) break;
+    }
+
+    // Gallop over the superblocks to find the last one with less than n bits before it
+    size_t sb = cursor.superblock;
+    size_t step = 1;
+    while (sb + step < rankSuperblocks.size() && countSB(sb + step) < n) {
+        sb += step;
+        step *= 2;
+    }
+    size_t lo = sb;
+    size_t hi = std::min(sb + step, rankSuperblocks.size());
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (countSB(mid) < n) lo = mid;
+        else hi = mid;
+    }
+    sb = lo;
+
+    // Blocks within the superblock
+    size_t blocksInSuperblock = rankSuperblockSize / rankBlockSize;
+    size_t block = sb * blocksInSuperblock;
+    while (block + 1 < rankBlocks.size() && block + 1 < (sb + 1) * blocksInSuperblock
+           && countBlock(sb, block + 1) < n) {
+        ++block;
+    }
+
+    // The block is shorter than 64 bits, so the answer is at most one word further
+    size_t start = block * rankBlockSize;
+    word = start / 64;
+    ones = rankSuperblocks[sb] + rankBlocks[block] - popcount64(bitvector[word] & lowerBits(start % 64));
+    while (true) {
+        uint64_t pattern = bit ? bitvector[word] : ~bitvector[word];
+        size_t before = countWord(word, ones);
+        if (before + popcount64(pattern) >= n) {
+            moveCursor(cursor, word, ones);
+            return word * 64 + selectInWord(pattern, n - before - 1);
+        }
+        ones += popcount64(bitvector[word]);
+        ++word;
+    }
+}
+
+size_t Bitvector::countOnes(size_t l, size_t r) {
+    size_t first = l / 64;
+    size_t last = r / 64;
+    if (last - first > cursorScanWords) {
+        return onesBefore(r) - onesBefore(l);
+    }
+
+    // Close range, count the words directly instead of two directory lookups
+    size_t ones = 0;
+    for (size_t k = first; k < last; ++k) {
+        ones += popcount64(bitvector[k]);
+    }
+    if (r % 64 != 0) {
+        ones += popcount64(bitvector[last] & lowerBits(r % 64));
+    }
+    if (l % 64 != 0) {
+        ones -= popcount64(bitvector[first] & lowerBits(l % 64));
+    }
+    return ones;
+}
+
+size_t Bitvector::selectFrom(bool bit, size_t l, size_t n) {
+    // Start a cursor at l, so select only scans forward from there
+    Cursor cursor;
+    size_t ones = onesBeforeWord(l / 64);
+    moveCursor(cursor, l / 64, ones);
+    if (l % 64 != 0) {
+        ones += popcount64(bitvector[l / 64] & lowerBits(l % 64));
+    }
+    return select(bit, (bit ? ones : l - ones) + n, cursor);
+}
+
+/**
+ * Streams once through the words and writes the running number of ones
+ */
+template <typename T>
+void exportRanksTo(const std::vector<uint64_t>& words, T* out, size_t count) {
+    T ones = 0;
+    for (size_t i = 0; i < count; i += 64) {
+        size_t end = std::min(count - i, static_cast<size_t>(64));
+        uint64_t chunk = i / 64 < words.size() ? words[i / 64] : 0;
+        for (size_t j = 0; j < end; ++j) {
+            out[i + j] = ones;
+            ones += static_cast<T>((chunk >> j) & 1);
+        }
+    }
+}
+
+void Bitvector::exportRanks(uint32_t* out, size_t count) const {
+    exportRanksTo(bitvector, out, count);
+}
+
+void Bitvector::exportRanks(uint64_t* out, size_t count) const {
+    exportRanksTo(bitvector, out, count);
+}
+
+size_t Bitvector::selectBits(size_t i, std::vector<SelectSB> &superblocks, const std::vector<std::vector<size_t>>& lookupTable, bool bit) {
     size_t index = 0;
     if (i/selectSBsize != 0) {
         index = superblocks[i/selectSBsize - 1].index;
@@ -306,10 +485,160 @@ size_t Bitvector::select(bool bit, size_t i) {
     }
 
     if (bit) {
-        return selectBits(i, selectOneSBs, selectOnesLookup, 1);
+        return selectBits(i, selectOneSBs, getSelectLookup().ones, 1);
     } else {
-        return selectBits(i, selectZeroSBs, selectZerosLookup, 1);
+        return selectBits(i, selectZeroSBs, getSelectLookup().zeros, 1);
+    }
+}
+
+// Binary images ---------------------------------------------------------------------------------------------- image
+const uint64_t imageMagic = 0x3230304d49564221; //< "!BVIM002"
+
+template <typename T>
+void writeValue(std::ostream& out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool readValue(std::istream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    return static_cast<bool>(in);
+}
+
+/**
+ * Vectors are stored as their length followed by the raw elements
+ */
+template <typename T>
+void writeVector(std::ostream& out, const std::vector<T>& values) {
+    writeValue<uint64_t>(out, values.size());
+    out.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+}
+
+/**
+ * Read a vector that must have exactly the given length. The length is
+ * checked before anything is allocated.
+ */
+template <typename T>
+bool readVector(std::istream& in, std::vector<T>& values, uint64_t expectedLength) {
+    uint64_t length;
+    if (!readValue(in, length) || length != expectedLength) return false;
+    values.resize(length);
+    in.read(reinterpret_cast<char*>(values.data()), static_cast<std::streamsize>(length * sizeof(T)));
+    return static_cast<bool>(in);
+}
+
+/**
+ * Number of ones in the bits [start, end) of packed words
+ */
+size_t onesInRange(const std::vector<uint64_t>& words, size_t start, size_t end) {
+    size_t ones = 0;
+    for (size_t w = start / 64; w * 64 < end; ++w) {
+        uint64_t word = words[w];
+        if (w == start / 64) word &= ~lowerBits(start % 64);
+        if ((w + 1) * 64 > end) word &= lowerBits(end % 64);
+        ones += popcount64(word);
+    }
+    return ones;
+}
+
+bool Bitvector::writeImage(std::ostream& out) const {
+    writeValue(out, imageMagic);
+    writeValue<uint64_t>(out, size);
+    writeValue<uint64_t>(out, rankBlockSize);
+    writeValue<uint64_t>(out, rankSuperblockSize);
+    writeValue<uint64_t>(out, selectSBsize);
+    writeValue<uint64_t>(out, selectBlockSize);
+    writeVector(out, bitvector);
+    writeVector(out, rankBlocks);
+    writeVector(out, rankSuperblocks);
+    writeVector(out, rankLookup);
+    for (auto* superblocks : {&selectOneSBs, &selectZeroSBs}) {
+        writeValue<uint64_t>(out, superblocks->size());
+        for (auto& superblock : *superblocks) {
+            writeValue<uint64_t>(out, superblock.index);
+            writeVector(out, superblock.sbSelect);
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+std::unique_ptr<Bitvector> Bitvector::readImage(std::istream& in, size_t expectedSize) {
+    uint64_t magic, size, rankBlockSize, rankSuperblockSize, selectSBsize, selectBlockSize;
+    if (!readValue(in, magic) || magic != imageMagic || !readValue(in, size) || size != expectedSize || size == 0
+        || !readValue(in, rankBlockSize) || !readValue(in, rankSuperblockSize)
+        || !readValue(in, selectSBsize) || !readValue(in, selectBlockSize)) {
+        return nullptr;
+    }
+
+    // The block sizes only depend on the size, compute them like the constructor does
+    std::unique_ptr<Bitvector> bv(new Bitvector());
+    double n = static_cast<double>(size);
+    bv->size = size;
+    bv->rankBlockSize = static_cast<size_t>(std::max(floor(log2(n) / 2), 1.0));
+    bv->rankSuperblockSize = bv->rankBlockSize * bv->rankBlockSize;
+    bv->selectSBsize = std::max(log2(n) * log2(n), 1.0);
+    bv->selectBlockSize = static_cast<size_t>(sqrt(log2(n)));
+    if (rankBlockSize != bv->rankBlockSize || rankSuperblockSize != bv->rankSuperblockSize
+        || selectSBsize != bv->selectSBsize || selectBlockSize != bv->selectBlockSize) {
+        return nullptr;
+    }
+
+    // Every vector must have exactly the length the constructor gives it
+    if (!readVector(in, bv->bitvector, size / 64 + (size % 64 == 0 ? 0 : 1))
+        || !readVector(in, bv->rankBlocks, size / rankBlockSize + (size % rankBlockSize == 0 ? 0 : 1))
+        || !readVector(in, bv->rankSuperblocks, size / rankSuperblockSize + (size % rankSuperblockSize == 0 ? 0 : 1))
+        || !readVector(in, bv->rankLookup, uint64_t(1) << (rankBlockSize - 1))) {
+        return nullptr;
+    }
+
+    // Bits after the end must be zero and the rank structures must match the bits,
+    // because rank and the cursors use them to index into the words
+    const std::vector<uint64_t>& words = bv->bitvector;
+    if (size % 64 != 0 && (words.back() & ~lowerBits(size % 64)) != 0) return nullptr;
+    size_t superblockOnes = 0;
+    size_t blockOnes = 0;
+    for (size_t block = 0; block < bv->rankBlocks.size(); ++block) {
+        size_t start = block * rankBlockSize;
+        if (start % rankSuperblockSize == 0) {
+            if (bv->rankSuperblocks[start / rankSuperblockSize] != superblockOnes) return nullptr;
+            blockOnes = 0;
+        }
+        if (bv->rankBlocks[block] != blockOnes) return nullptr;
+        size_t ones = onesInRange(words, start, std::min(start + rankBlockSize, static_cast<size_t>(size)));
+        blockOnes += ones;
+        superblockOnes += ones;
+    }
+    for (size_t i = 0; i < bv->rankLookup.size(); ++i) {
+        if (bv->rankLookup[i] != countOneBits(i)) return nullptr;
+    }
+
+    size_t k1 = onesInRange(words, 0, size);
+    size_t counts[2] = {k1, size - k1};
+    size_t blocksInSB = selectBlockSize == 0 ? 0 : selectSBsize / selectBlockSize + (selectSBsize % selectBlockSize == 0 ? 0 : 1);
+    std::vector<SelectSB>* superblockLists[2] = {&bv->selectOneSBs, &bv->selectZeroSBs};
+    for (size_t k = 0; k < 2; ++k) {
+        uint64_t count;
+        if (!readValue(in, count) || count != counts[k] / selectSBsize + (counts[k] % selectSBsize == 0 ? 0 : 1)) {
+            return nullptr;
+        }
+        superblockLists[k]->resize(count);
+        for (auto& superblock : *superblockLists[k]) {
+            uint64_t index, length;
+            if (!readValue(in, index) || index >= size || !readValue(in, length)) return nullptr;
+            // Superblocks are either a list of selectSBsize entries or divided into blocks
+            if (length != selectSBsize && length != blocksInSB) return nullptr;
+            superblock.sbSelect.resize(length);
+            in.read(reinterpret_cast<char*>(superblock.sbSelect.data()),
+                    static_cast<std::streamsize>(length * sizeof(size_t)));
+            if (!in) return nullptr;
+            for (size_t entry : superblock.sbSelect) {
+                if (entry >= size) return nullptr;
+            }
+            superblock.index = index;
+        }
     }
+    bv->selectLookup = std::make_shared<SelectLookup>();
+    return bv;
 }
 
 size_t Bitvector::getSpace() {
@@ -3,10 +3,26 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
 #include <vector>
 #include <string>
 
 class Bitvector {
+public:
+    /**
+     * Remembers where the last cursor query ended. Rank and select calls that
+     * move forward from there only scan a few words instead of starting over
+     * in the rank directories. A default constructed cursor starts at the front.
+     */
+    struct Cursor {
+        size_t superblock = 0;      //< Rank superblock of word
+        size_t word = 0;            //< Last visited uint64_t of the bitvector
+        size_t onesBeforeWord = 0;  //< Number of ones before word
+    };
+
 private:
     struct SelectBlock {
         size_t index;
@@ -31,13 +47,53 @@ private:
      */
     size_t blockLookupOnes(size_t i);
 
-    size_t selectBits(size_t i, std::vector<SelectSB>& superblocks, std::vector<std::vector<size_t>>& lookupTable, bool bit);
+    size_t selectBits(size_t i, std::vector<SelectSB>& superblocks, const std::vector<std::vector<size_t>>& lookupTable, bool bit);
 
     void buildSelectStructure(std::vector<SelectSB>& superblocks, char bit, std::string& bits, size_t numberOfBits);
 
     void buildSelectLookup(std::vector<std::vector<size_t>>& table, bool bit);
 
+    /**
+     * Lookup tables for select blocks. They only depend on the size, so they are
+     * built on the first select and shared by copies of the bitvector.
+     */
+    struct SelectLookup {
+        std::once_flag built;
+        std::vector<std::vector<size_t>> ones;
+        std::vector<std::vector<size_t>> zeros;
+    };
+
+    /**
+     * Get the select lookup tables, build them if this is the first call
+     */
+    const SelectLookup& getSelectLookup();
+
     size_t getRange(size_t start, size_t end);
+
+    /**
+     * Empty bitvector, only used to read images
+     */
+    Bitvector() = default;
+
+    /**
+     * Get the number of ones before the uint64_t at index word.
+     * Also valid for word == bitvector.size() if the bitvector is a multiple of 64
+     * @param word Index of the uint64_t
+     * @return Number of ones before the word
+     */
+    size_t onesBeforeWord(size_t word);
+
+    /**
+     * Get the number of ones before index i. Valid for 0 <= i <= getSize()
+     */
+    size_t onesBefore(size_t i);
+
+    /**
+     * Set the cursor to the beginning of word
+     */
+    void moveCursor(Cursor& cursor, size_t word, size_t ones) const;
+
+    static const size_t cursorScanWords = 8; //< Words a cursor scans before seeking via directories
 public:
     explicit Bitvector(std::string bits);
 
@@ -47,6 +103,13 @@ public:
      */
     size_t getSize() const;
 
+    /**
+     * Get the packed bits. Bit i is bit i % 64 of word i / 64,
+     * bits after the end of the bitvector are zero.
+     * @return The words of the bitvector
+     */
+    const std::vector<uint64_t>& getWords() const;
+
     /**
      * Access the bit a specific index.
      * Undefined behaviour for out-of-range access
@@ -74,6 +137,76 @@ public:
      */
     size_t rank(bool bit, size_t i);
 
+    /**
+     * Same as rank, but starts from the position of the cursor.
+     * Increasing indices only scan the words in between, others seek
+     * directly via the rank directories. Valid for 0 <= i <= getSize().
+     * @param bit What bit to track
+     * @param i The index to begin tracking
+     * @param cursor Position of the previous query, updated to i
+     * @return Number of bits of type bit before the index i
+     */
+    size_t rank(bool bit, size_t i, Cursor& cursor);
+
+    /**
+     * Same as select, but starts from the position of the cursor.
+     * Short forward moves scan word by word, long ones gallop over the
+     * rank superblocks. Moves backwards restart at the front.
+     * Assumes that there is actually a position with n bits of type bit!
+     * @param bit What bit to track
+     * @param n Amount of bits before position
+     * @param cursor Position of the previous query, updated to the result
+     * @return The index where n bits are before
+     */
+    size_t select(bool bit, size_t n, Cursor& cursor);
+
+    /**
+     * Get the number of ones in the range [l, r).
+     * Undefined behaviour unless l <= r <= getSize()!
+     * @param l First index of the range
+     * @param r Index after the range
+     * @return Number of ones in the range
+     */
+    size_t countOnes(size_t l, size_t r);
+
+    /**
+     * Get the position of the n-th bit of type bit at or after index l.
+     * Assumes that there is actually a position. If there are less than n
+     * bits of type bit after l the behaviour is undefined!
+     * @param bit What bit to track
+     * @param l The index to begin searching
+     * @param n Amount of bits from l on, starting at 1
+     * @return The index of the n-th bit at or after l
+     */
+    size_t selectFrom(bool bit, size_t l, size_t n);
+
+    /**
+     * Write rank(1, i) for every i < count into out in one pass over the bitvector.
+     * Undefined behaviour for count > getSize() + 1!
+     * @param out Array with at least count entries
+     * @param count Number of prefix ranks to export
+     */
+    void exportRanks(uint32_t* out, size_t count) const;
+    void exportRanks(uint64_t* out, size_t count) const;
+
+    /**
+     * Write a binary image of the bitvector and all helper structures.
+     * The select lookup tables only depend on the size and are not part of the image.
+     * @param out Binary stream
+     * @return Whether writing succeeded
+     */
+    bool writeImage(std::ostream& out) const;
+
+    /**
+     * Read a binary image written by writeImage instead of building the bitvector.
+     * Block sizes and vector lengths must be exactly those the constructor gives a
+     * bitvector of expectedSize bits, and the rank structures must match the bits.
+     * @param in Binary stream
+     * @param expectedSize Number of bits the image must have
+     * @return The bitvector or nullptr if the image is invalid
+     */
+    static std::unique_ptr<Bitvector> readImage(std::istream& in, size_t expectedSize);
+
     /**
      * Returns the size of the class
      * @return size in bits
@@ -92,8 +225,7 @@ private:
     size_t selectBlockSize;                //< How many bits of one kind are in select block
     std::vector<SelectSB> selectZeroSBs;     //< Select superblocks for zeros
     std::vector<SelectSB> selectOneSBs;      //< Select superblocks for ones
-    std::vector<std::vector<size_t>> selectOnesLookup;  //< Ones Lookup table for select
-    std::vector<std::vector<size_t>> selectZerosLookup; //< Ones Lookup table for select
+    std::shared_ptr<SelectLookup> selectLookup;         //< Lookup tables for select, built lazily
 };
 
 
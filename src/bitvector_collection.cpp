@@ -0,0 +1,123 @@
+#include "bitvector_collection.hpp"
+#include "word_ops.hpp"
+
+const size_t BitvectorCollection::blockBits;
+const size_t BitvectorCollection::blockWords;
+
+size_t BitvectorCollection::add(const std::string& bits) {
+    Header header{arena.size(), bits.size()};
+    size_t blocks = bits.size() / blockBits + 1;
+    arena.resize(arena.size() + blocks * (blockWords + 1), 0);
+
+    size_t ones = 0;
+    for (size_t block = 0; block < blocks; ++block) {
+        uint64_t* words = &arena[header.offset + block * (blockWords + 1)];
+        words[0] = ones;
+        for (size_t i = block * blockBits; i < (block + 1) * blockBits && i < bits.size(); ++i) {
+            if (bits[i] == '1') {
+                words[1 + (i % blockBits) / 64] |= static_cast<uint64_t>(1) << (i % 64);
+                ++ones;
+            }
+        }
+    }
+    headers.push_back(header);
+    return headers.size() - 1;
+}
+
+size_t BitvectorCollection::count() const {
+    return headers.size();
+}
+
+size_t BitvectorCollection::getSize(size_t id) const {
+    return headers[id].size;
+}
+
+bool BitvectorCollection::access(size_t id, size_t i) const {
+    const uint64_t* block = &arena[headers[id].offset + i / blockBits * (blockWords + 1)];
+    return (block[1 + (i % blockBits) / 64] >> (i % 64)) & 1;
+}
+
+size_t BitvectorCollection::rank(size_t id, bool bit, size_t i) const {
+    const uint64_t* block = &arena[headers[id].offset + i / blockBits * (blockWords + 1)];
+    size_t ones = block[0];
+    size_t word = (i % blockBits) / 64;
+    for (size_t k = 0; k < word; ++k) {
+        ones += popcount64(block[1 + k]);
+    }
+    ones += popcount64(block[1 + word] & lowerBits(i % 64));
+    return bit ? ones : i - ones;
+}
+
+size_t BitvectorCollection::selectInBlock(const Header& header, size_t block, bool bit, size_t n) const {
+    const uint64_t* words = &arena[header.offset + block * (blockWords + 1)];
+    size_t before = blockCount(header, block, bit);
+    for (size_t k = 0; ; ++k) {
+        uint64_t pattern = bit ? words[1 + k] : ~words[1 + k];
+        size_t count = popcount64(pattern);
+        if (before + count >= n) {
+            return block * blockBits + k * 64 + selectInWord(pattern, n - before - 1);
+        }
+        before += count;
+    }
+}
+
+size_t BitvectorCollection::select(size_t id, bool bit, size_t n) const {
+    const Header& header = headers[id];
+    // Find the last block with less than n bits before it
+    size_t lo = 0;
+    size_t hi = header.size / blockBits + 1;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (blockCount(header, mid, bit) < n) lo = mid;
+        else hi = mid;
+    }
+    return selectInBlock(header, lo, bit, n);
+}
+
+void BitvectorCollection::rankMany(const std::vector<size_t>& ids, bool bit, size_t i, std::vector<size_t>& out) const {
+    out.resize(ids.size());
+    size_t offset = i / blockBits * (blockWords + 1);
+    for (size_t id : ids) {
+        prefetchWord(&arena[headers[id].offset + offset]);
+    }
+    for (size_t k = 0; k < ids.size(); ++k) {
+        out[k] = rank(ids[k], bit, i);
+    }
+}
+
+void BitvectorCollection::selectMany(const std::vector<size_t>& ids, bool bit, size_t n, std::vector<size_t>& out) const {
+    std::vector<size_t> lo(ids.size(), 0);
+    std::vector<size_t> hi(ids.size());
+    for (size_t k = 0; k < ids.size(); ++k) {
+        hi[k] = headers[ids[k]].size / blockBits + 1;
+    }
+
+    bool searching = true;
+    while (searching) {
+        searching = false;
+        // Prefetch the middle block of every search, then read them all
+        for (size_t k = 0; k < ids.size(); ++k) {
+            if (hi[k] - lo[k] > 1) {
+                size_t mid = lo[k] + (hi[k] - lo[k]) / 2;
+                prefetchWord(&arena[headers[ids[k]].offset + mid * (blockWords + 1)]);
+            }
+        }
+        for (size_t k = 0; k < ids.size(); ++k) {
+            if (hi[k] - lo[k] > 1) {
+                size_t mid = lo[k] + (hi[k] - lo[k]) / 2;
+                if (blockCount(headers[ids[k]], mid, bit) < n) lo[k] = mid;
+                else hi[k] = mid;
+                searching = true;
+            }
+        }
+    }
+
+    out.resize(ids.size());
+    for (size_t k = 0; k < ids.size(); ++k) {
+        out[k] = selectInBlock(headers[ids[k]], lo[k], bit, n);
+    }
+}
+
+size_t BitvectorCollection::getSpace() const {
+    return (sizeof(*this) + arena.size() * sizeof(uint64_t) + headers.size() * sizeof(Header)) * 8;
+}
@@ -0,0 +1,110 @@
+#ifndef BITVECTOR_BITVECTOR_COLLECTION_HPP
+#define BITVECTOR_BITVECTOR_COLLECTION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Many bitvectors packed into one contiguous arena of 64-bit words.
+ *
+ * Every bitvector is a sequence of blocks of 512 bits. A block is one word
+ * with the number of ones before the block followed by its eight data words,
+ * so rank reads one short stretch of the arena. There is always a block after
+ * the last bit, which makes rank at the end work like any other index.
+ * Per bitvector only a header with the offset into the arena and the size is
+ * stored, no lookup tables or allocations of its own.
+ */
+class BitvectorCollection {
+public:
+    static const size_t blockBits = 512;            //< Bits per block
+    static const size_t blockWords = blockBits / 64; //< Data words per block
+
+    /**
+     * Append a bitvector to the arena
+     * @param bits Bits as a string of '0' and '1'
+     * @return Id of the bitvector, ids are consecutive starting at 0
+     */
+    size_t add(const std::string& bits);
+
+    /**
+     * @return Number of bitvectors in the collection
+     */
+    size_t count() const;
+
+    /**
+     * @param id Id of the bitvector
+     * @return Size of the bitvector
+     */
+    size_t getSize(size_t id) const;
+
+    /**
+     * Access the bit at a specific index of a bitvector.
+     * Undefined behaviour for out-of-range access
+     */
+    bool access(size_t id, size_t i) const;
+
+    /**
+     * Get the number of bits bit before index i in a bitvector.
+     * Valid for 0 <= i <= getSize(id)
+     */
+    size_t rank(size_t id, bool bit, size_t i) const;
+
+    /**
+     * Get the position of the n-th bit of type bit in a bitvector.
+     * Assumes that there is actually a position!
+     */
+    size_t select(size_t id, bool bit, size_t n) const;
+
+    /**
+     * Rank at the same index in several bitvectors. All blocks are
+     * prefetched before the first one is read.
+     * @param ids Ids of the bitvectors
+     * @param bit What bit to track
+     * @param i Index, valid in all bitvectors
+     * @param out Resized to ids.size(), out[k] is the rank in bitvector ids[k]
+     */
+    void rankMany(const std::vector<size_t>& ids, bool bit, size_t i, std::vector<size_t>& out) const;
+
+    /**
+     * Select the same n in several bitvectors. The binary searches over the
+     * blocks run in lockstep, so the reads of one step overlap.
+     * @param ids Ids of the bitvectors
+     * @param bit What bit to track
+     * @param n Amount of bits before position, valid in all bitvectors
+     * @param out Resized to ids.size(), out[k] is the position in bitvector ids[k]
+     */
+    void selectMany(const std::vector<size_t>& ids, bool bit, size_t n, std::vector<size_t>& out) const;
+
+    /**
+     * Returns the size of the collection
+     * @return size in bits
+     */
+    size_t getSpace() const;
+
+private:
+    struct Header {
+        uint64_t offset;    //< First word of the bitvector in the arena
+        uint64_t size;      //< Number of bits
+    };
+
+    /**
+     * Number of bits of type bit before a block
+     */
+    size_t blockCount(const Header& header, size_t block, bool bit) const {
+        size_t ones = arena[header.offset + block * (blockWords + 1)];
+        return bit ? ones : block * blockBits - ones;
+    }
+
+    /**
+     * Find the n-th bit of type bit within a block
+     */
+    size_t selectInBlock(const Header& header, size_t block, bool bit, size_t n) const;
+
+    std::vector<uint64_t> arena;     //< Blocks of all bitvectors
+    std::vector<Header> headers;     //< One header per bitvector
+};
+
+
+#endif //BITVECTOR_BITVECTOR_COLLECTION_HPP
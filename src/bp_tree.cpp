@@ -0,0 +1,312 @@
+#include "bp_tree.hpp"
+
+#include <algorithm>
+
+const size_t BpTree::npos;
+
+/**
+ * Excess lookup tables for all bytes, read from the lowest to the highest bit.
+ * Minimum and maximum are over the non-empty prefixes of the byte.
+ */
+struct ExcessTables {
+    int8_t excess[256];
+    int8_t minExcess[256];
+    int8_t maxExcess[256];
+
+    ExcessTables() {
+        for (size_t pattern = 0; pattern < 256; ++pattern) {
+            int8_t cur = 0;
+            minExcess[pattern] = 8;
+            maxExcess[pattern] = -8;
+            for (size_t j = 0; j < 8; ++j) {
+                cur += ((pattern >> j) & 1) ? 1 : -1;
+                minExcess[pattern] = std::min(minExcess[pattern], cur);
+                maxExcess[pattern] = std::max(maxExcess[pattern], cur);
+            }
+            excess[pattern] = cur;
+        }
+    }
+};
+
+const ExcessTables& excessTables() {
+    static const ExcessTables tables;
+    return tables;
+}
+
+/**
+ * Excess values that never match, used for the leaves after the last word
+ */
+const int64_t noExcess = INT64_MAX / 4;
+
+BpTree::BpTree(Bitvector& bitvector)
+: bitvector(bitvector),
+  words(bitvector.getWords()),
+  size(bitvector.getSize()),
+  leaves(1) {
+    while (leaves < words.size()) leaves *= 2;
+    tree.assign(2 * leaves, Node{0, noExcess, -noExcess});
+
+    // Leaves, one per word
+    for (size_t w = 0; w < words.size(); ++w) {
+        Node& leaf = tree[leaves + w];
+        int64_t cur = 0;
+        leaf.minExcess = noExcess;
+        leaf.maxExcess = -noExcess;
+        for (size_t j = 0; j < bitsInWord(w); ++j) {
+            cur += ((words[w] >> j) & 1) ? 1 : -1;
+            leaf.minExcess = std::min(leaf.minExcess, cur);
+            leaf.maxExcess = std::max(leaf.maxExcess, cur);
+        }
+        leaf.excess = cur;
+    }
+
+    // Inner nodes from the bottom up
+    for (size_t k = leaves - 1; k > 0; --k) {
+        const Node& left = tree[2 * k];
+        const Node& right = tree[2 * k + 1];
+        tree[k].excess = left.excess + right.excess;
+        tree[k].minExcess = std::min(left.minExcess, left.excess + right.minExcess);
+        tree[k].maxExcess = std::max(left.maxExcess, left.excess + right.maxExcess);
+    }
+}
+
+size_t BpTree::bitsInWord(size_t word) const {
+    return std::min(size - word * 64, static_cast<size_t>(64));
+}
+
+int64_t BpTree::excess(size_t i) {
+    return 2 * static_cast<int64_t>(bitvector.countOnes(0, i + 1)) - static_cast<int64_t>(i + 1);
+}
+
+size_t BpTree::scanForward(size_t word, size_t from, size_t to, int64_t& cur, int64_t target) const {
+    const ExcessTables& tables = excessTables();
+    uint64_t bits = words[word];
+    while (from < to) {
+        if (from % 8 == 0 && from + 8 <= to) {
+            uint8_t pattern = static_cast<uint8_t>(bits >> from);
+            int64_t offset = target - cur;
+            if (offset < tables.minExcess[pattern] || offset > tables.maxExcess[pattern]) {
+                // Target is not within this byte
+                cur += tables.excess[pattern];
+                from += 8;
+                continue;
+            }
+        }
+        cur += ((bits >> from) & 1) ? 1 : -1;
+        if (cur == target) return word * 64 + from;
+        ++from;
+    }
+    return npos;
+}
+
+size_t BpTree::scanBackward(size_t word, size_t from, size_t to, int64_t& cur, int64_t target) const {
+    const ExcessTables& tables = excessTables();
+    uint64_t bits = words[word];
+    while (to > from) {
+        if (to % 8 == 0 && to - 8 >= from) {
+            uint8_t pattern = static_cast<uint8_t>(bits >> (to - 8));
+            int64_t start = cur - tables.excess[pattern];
+            int64_t offset = target - start;
+            if (offset < tables.minExcess[pattern] || offset > tables.maxExcess[pattern]) {
+                // Target is not within this byte
+                cur = start;
+                to -= 8;
+                continue;
+            }
+        }
+        if (cur == target) return word * 64 + to;
+        --to;
+        cur -= ((bits >> to) & 1) ? 1 : -1;
+    }
+    return npos;
+}
+
+void BpTree::scanMin(size_t word, size_t from, size_t to, int64_t& cur, int64_t& best, size_t& bestPos) const {
+    const ExcessTables& tables = excessTables();
+    uint64_t bits = words[word];
+    while (from < to) {
+        if (from % 8 == 0 && from + 8 <= to) {
+            uint8_t pattern = static_cast<uint8_t>(bits >> from);
+            if (cur + tables.minExcess[pattern] >= best) {
+                // No new minimum within this byte
+                cur += tables.excess[pattern];
+                from += 8;
+                continue;
+            }
+        }
+        cur += ((bits >> from) & 1) ? 1 : -1;
+        if (cur < best) {
+            best = cur;
+            bestPos = word * 64 + from;
+        }
+        ++from;
+    }
+}
+
+size_t BpTree::forwardSearch(size_t i, int64_t target) {
+    size_t word = i / 64;
+    int64_t cur = excess(i);
+    size_t res = scanForward(word, i % 64 + 1, bitsInWord(word), cur, target);
+    if (res != npos) return res;
+
+    // Go up until a right sibling contains the target
+    size_t node = leaves + word;
+    while (node > 1) {
+        if (node % 2 == 0) {
+            const Node& sibling = tree[node + 1];
+            if (inRange(sibling, target - cur)) {
+                node = node + 1;
+                break;
+            }
+            cur += sibling.excess;
+        }
+        node /= 2;
+    }
+    if (node == 1) return npos;
+
+    // Go down to the leftmost leaf that contains the target
+    while (node < leaves) {
+        const Node& left = tree[2 * node];
+        if (inRange(left, target - cur)) {
+            node = 2 * node;
+        } else {
+            cur += left.excess;
+            node = 2 * node + 1;
+        }
+    }
+    word = node - leaves;
+    return scanForward(word, 0, bitsInWord(word), cur, target);
+}
+
+size_t BpTree::backwardSearch(size_t i, int64_t target) {
+    size_t word = i / 64;
+    int64_t cur = excess(i) - (bitvector.access(i) ? 1 : -1);
+    size_t res = scanBackward(word, 0, i % 64, cur, target);
+    if (res != npos) return res;
+
+    // Go up until a left sibling contains the target
+    size_t node = leaves + word;
+    while (node > 1) {
+        if (node % 2 == 1) {
+            const Node& sibling = tree[node - 1];
+            if (inRange(sibling, target - (cur - sibling.excess))) {
+                node = node - 1;
+                break;
+            }
+            cur -= sibling.excess;
+        }
+        node /= 2;
+    }
+    if (node == 1) {
+        // Only the position before the first parenthesis is left
+        return target == 0 ? 0 : npos;
+    }
+
+    // Go down to the rightmost leaf that contains the target
+    while (node < leaves) {
+        const Node& right = tree[2 * node + 1];
+        if (inRange(right, target - (cur - right.excess))) {
+            node = 2 * node + 1;
+        } else {
+            cur -= right.excess;
+            node = 2 * node;
+        }
+    }
+    word = node - leaves;
+    return scanBackward(word, 0, bitsInWord(word), cur, target);
+}
+
+size_t BpTree::minExcessPosition(size_t i, size_t j) {
+    size_t first = i / 64;
+    size_t last = j / 64;
+    int64_t cur = excess(i);
+    int64_t best = cur;
+    size_t bestPos = i;
+    if (first == last) {
+        scanMin(first, i % 64 + 1, j % 64 + 1, cur, best, bestPos);
+        return bestPos;
+    }
+    scanMin(first, i % 64 + 1, bitsInWord(first), cur, best, bestPos);
+
+    // Cover the words in between with tree nodes from left to right,
+    // at most one node per level and side
+    size_t nodes[2 * 64];
+    size_t rightNodes[64];
+    size_t numNodes = 0;
+    size_t numRightNodes = 0;
+    for (size_t lo = leaves + first + 1, hi = leaves + last; lo < hi; lo /= 2, hi /= 2) {
+        if (lo % 2 == 1) nodes[numNodes++] = lo++;
+        if (hi % 2 == 1) rightNodes[numRightNodes++] = --hi;
+    }
+    while (numRightNodes > 0) nodes[numNodes++] = rightNodes[--numRightNodes];
+
+    size_t bestNode = 0;
+    int64_t bestNodeStart = 0;
+    for (size_t k = 0; k < numNodes; ++k) {
+        size_t node = nodes[k];
+        if (cur + tree[node].minExcess < best) {
+            best = cur + tree[node].minExcess;
+            bestNode = node;
+            bestNodeStart = cur;
+        }
+        cur += tree[node].excess;
+    }
+
+    size_t lastPos = bestPos;
+    scanMin(last, 0, j % 64 + 1, cur, best, bestPos);
+    if (bestNode == 0 || bestPos != lastPos) return bestPos;
+
+    // Minimum is within a node, go down to its leftmost occurrence
+    cur = bestNodeStart;
+    size_t node = bestNode;
+    while (node < leaves) {
+        const Node& left = tree[2 * node];
+        if (cur + left.minExcess == best) {
+            node = 2 * node;
+        } else {
+            cur += left.excess;
+            node = 2 * node + 1;
+        }
+    }
+    return scanForward(node - leaves, 0, bitsInWord(node - leaves), cur, best);
+}
+
+size_t BpTree::findClose(size_t i) {
+    return forwardSearch(i, excess(i) - 1);
+}
+
+size_t BpTree::findOpen(size_t i) {
+    return backwardSearch(i, excess(i));
+}
+
+size_t BpTree::enclose(size_t i) {
+    return backwardSearch(i, excess(i) - 2);
+}
+
+size_t BpTree::parent(size_t i) {
+    return enclose(i);
+}
+
+size_t BpTree::firstChild(size_t i) {
+    return i + 1 < size && bitvector.access(i + 1) ? i + 1 : npos;
+}
+
+size_t BpTree::nextSibling(size_t i) {
+    size_t close = findClose(i);
+    return close + 1 < size && bitvector.access(close + 1) ? close + 1 : npos;
+}
+
+size_t BpTree::subtreeSize(size_t i) {
+    return (findClose(i) - i + 1) / 2;
+}
+
+size_t BpTree::lca(size_t i, size_t j) {
+    if (i > j) std::swap(i, j);
+    if (i == j || findClose(i) > j) return i;
+    // The minimum between both nodes closes the child of the lca that contains i
+    return parent(minExcessPosition(i, j) + 1);
+}
+
+size_t BpTree::getSpace() const {
+    return (sizeof(*this) + tree.size() * sizeof(Node)) * 8;
+}
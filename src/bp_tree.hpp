@@ -0,0 +1,157 @@
+#ifndef BITVECTOR_BP_TREE_HPP
+#define BITVECTOR_BP_TREE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "bitvector.hpp"
+
+/**
+ * Ordinal tree stored as balanced parentheses in a bitvector. A one is an
+ * opening and a zero a closing parenthesis, a node is identified by the
+ * index of its opening parenthesis.
+ *
+ * Navigation is reduced to searches for an excess (opening minus closing
+ * parentheses up to and including an index). A range min-max tree over the
+ * 64-bit words stores the total, minimum and maximum excess of every range,
+ * so a search only looks at O(log n) nodes and two words. Within words,
+ * bytes are skipped via lookup tables.
+ */
+class BpTree {
+public:
+    static const size_t npos = static_cast<size_t>(-1); //< Returned if there is no such node
+
+    /**
+     * The bitvector has to stay alive and unchanged as long as the tree is used.
+     * Undefined behaviour for bitvectors that are not balanced!
+     * @param bitvector Balanced parentheses
+     */
+    explicit BpTree(Bitvector& bitvector);
+
+    /**
+     * Get the matching closing parenthesis
+     * @param i Index of an opening parenthesis
+     * @return Index of the matching closing parenthesis
+     */
+    size_t findClose(size_t i);
+
+    /**
+     * Get the matching opening parenthesis
+     * @param i Index of a closing parenthesis
+     * @return Index of the matching opening parenthesis
+     */
+    size_t findOpen(size_t i);
+
+    /**
+     * Get the opening parenthesis of the closest pair enclosing i
+     * @param i Index of an opening parenthesis
+     * @return Index of the enclosing opening parenthesis or npos
+     */
+    size_t enclose(size_t i);
+
+    /**
+     * @param i Node
+     * @return Parent of the node or npos for a root
+     */
+    size_t parent(size_t i);
+
+    /**
+     * @param i Node
+     * @return First child of the node or npos for a leaf
+     */
+    size_t firstChild(size_t i);
+
+    /**
+     * @param i Node
+     * @return Next sibling of the node or npos for the last child
+     */
+    size_t nextSibling(size_t i);
+
+    /**
+     * @param i Node
+     * @return Number of nodes in the subtree of the node, including itself
+     */
+    size_t subtreeSize(size_t i);
+
+    /**
+     * Get the lowest common ancestor of two nodes in the same tree
+     * @param i Node
+     * @param j Node
+     * @return Deepest node that has both nodes in its subtree
+     */
+    size_t lca(size_t i, size_t j);
+
+    /**
+     * Returns the size of the range min-max tree
+     * @return size in bits
+     */
+    size_t getSpace() const;
+
+private:
+    struct Node {
+        int64_t excess;     //< Excess of the whole range
+        int64_t minExcess;  //< Minimum excess of a non-empty prefix of the range
+        int64_t maxExcess;  //< Maximum excess of a non-empty prefix of the range
+    };
+
+    /**
+     * Get the excess up to and including index i
+     */
+    int64_t excess(size_t i);
+
+    /**
+     * Get the smallest j > i with excess(j) == target
+     * @return j or npos
+     */
+    size_t forwardSearch(size_t i, int64_t target);
+
+    /**
+     * Get the largest j < i with excess(j) == target. excess(-1) is 0.
+     * @return j + 1 or npos
+     */
+    size_t backwardSearch(size_t i, int64_t target);
+
+    /**
+     * Get the leftmost index of the minimum excess in [i, j]
+     */
+    size_t minExcessPosition(size_t i, size_t j);
+
+    /**
+     * Scan the bits [from, to) of a word forwards until the excess is target
+     * @param cur Excess before from, afterwards excess at the last scanned bit
+     * @return Index of the bit in the bitvector or npos
+     */
+    size_t scanForward(size_t word, size_t from, size_t to, int64_t& cur, int64_t target) const;
+
+    /**
+     * Scan the bits [from, to) of a word backwards until the excess is target
+     * @param cur Excess at to - 1, afterwards excess before the last scanned bit
+     * @return Index of the bit in the bitvector + 1 or npos
+     */
+    size_t scanBackward(size_t word, size_t from, size_t to, int64_t& cur, int64_t target) const;
+
+    /**
+     * Track the leftmost minimum excess over the bits [from, to) of a word
+     * @param cur Excess before from, afterwards excess at to - 1
+     */
+    void scanMin(size_t word, size_t from, size_t to, int64_t& cur, int64_t& best, size_t& bestPos) const;
+
+    /**
+     * Number of valid bits in a word
+     */
+    size_t bitsInWord(size_t word) const;
+
+    bool inRange(const Node& node, int64_t offset) const {
+        return node.minExcess <= offset && offset <= node.maxExcess;
+    }
+
+    Bitvector& bitvector;
+    const std::vector<uint64_t>& words;
+    size_t size;                   //< Number of parentheses
+    size_t leaves;                 //< Number of leaves, power of two, one word per leaf
+    std::vector<Node> tree;        //< Range min-max tree, root at 1, children of k at 2k and 2k+1
+};
+
+
+#endif //BITVECTOR_BP_TREE_HPP
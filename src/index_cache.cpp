@@ -0,0 +1,103 @@
+#include "index_cache.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+
+/**
+ * Pack up to 64 chars into a word like the bitvector does, bit j is set if char j is '1'.
+ * Eight chars of '0' and '1' are packed at once (little endian), other chars go the slow way.
+ */
+static uint64_t packWord(const char* chars, size_t count) {
+    const uint64_t zeros = 0x3030303030303030;  //< Eight '0'
+    const uint64_t lowBits = 0x0101010101010101;
+    uint64_t word = 0;
+    size_t j = 0;
+    for (; j + 8 <= count; j += 8) {
+        uint64_t chunk;
+        memcpy(&chunk, chars + j, 8);
+        chunk ^= zeros;
+        if ((chunk & ~lowBits) == 0) {
+            // Every byte is 0 or 1, gather byte k into bit k of the top byte
+            word |= ((chunk * 0x0102040810204080) >> 56) << j;
+        } else {
+            for (size_t k = j; k < j + 8; ++k) {
+                if (chars[k] == '1') word |= static_cast<uint64_t>(1) << k;
+            }
+        }
+    }
+    for (; j < count; ++j) {
+        if (chars[j] == '1') word |= static_cast<uint64_t>(1) << j;
+    }
+    return word;
+}
+
+IndexCache::IndexCache(std::string directory)
+: directory(std::move(directory)) {}
+
+uint64_t IndexCache::hash(const std::string& bits) {
+    const uint64_t prime = 0x9e3779b97f4a7c15;
+    uint64_t h = bits.size() * prime;
+    size_t i = 0;
+    for (; i + 8 <= bits.size(); i += 8) {
+        uint64_t chunk;
+        memcpy(&chunk, bits.data() + i, 8);
+        h = (h ^ chunk) * prime;
+        h ^= h >> 29;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, bits.data() + i, bits.size() - i);
+    h = (h ^ tail) * prime;
+
+    // Final mix, so every input bit affects every output bit
+    h ^= h >> 32;
+    h *= 0xd6e8feb86659fd93;
+    h ^= h >> 32;
+    return h;
+}
+
+std::string IndexCache::imagePath(const std::string& bits) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bvi", static_cast<unsigned long long>(hash(bits)));
+    return directory + "/" + name;
+}
+
+std::unique_ptr<Bitvector> IndexCache::load(const std::string& bits) const {
+    std::ifstream in(imagePath(bits), std::ios::binary);
+    if (!in.is_open()) return nullptr;
+
+    auto bitvector = Bitvector::readImage(in, bits.size());
+    if (!bitvector) return nullptr;
+
+    // The name is only a hash, so check that the image really holds these bits
+    const std::vector<uint64_t>& words = bitvector->getWords();
+    for (size_t i = 0; i < bits.size(); i += 64) {
+        if (words[i / 64] != packWord(bits.data() + i, std::min<size_t>(64, bits.size() - i))) return nullptr;
+    }
+    return bitvector;
+}
+
+bool IndexCache::store(const std::string& bits, const Bitvector& bitvector) const {
+    std::string path = imagePath(bits);
+    std::string tmpPath = path + "." + std::to_string(getpid()) + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary);
+        if (!out.is_open() || !bitvector.writeImage(out)) {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    }
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
+
+std::unique_ptr<Bitvector> IndexCache::getOrBuild(const std::string& bits, bool& cached) {
+    auto bitvector = load(bits);
+    cached = bitvector != nullptr;
+    if (!cached) {
+        bitvector.reset(new Bitvector(bits));
+        store(bits, *bitvector);
+    }
+    return bitvector;
+}
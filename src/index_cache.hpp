@@ -0,0 +1,60 @@
+#ifndef BITVECTOR_INDEX_CACHE_HPP
+#define BITVECTOR_INDEX_CACHE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "bitvector.hpp"
+
+/**
+ * Directory of bitvector images, keyed by a hash of the bit string.
+ * Repeated runs over the same input read the image instead of building the bitvector.
+ */
+class IndexCache {
+public:
+    /**
+     * @param directory Existing directory for the images
+     */
+    explicit IndexCache(std::string directory);
+
+    /**
+     * Get the bitvector for bits from the cache or build and store it
+     * @param bits Bit string of the bitvector
+     * @param cached Set to whether the bitvector was read from the cache
+     * @return The bitvector
+     */
+    std::unique_ptr<Bitvector> getOrBuild(const std::string& bits, bool& cached);
+
+    /**
+     * Read the image for bits. Images of other bits with the same hash are rejected.
+     * @param bits Bit string of the bitvector
+     * @return The bitvector or nullptr if there is no valid image
+     */
+    std::unique_ptr<Bitvector> load(const std::string& bits) const;
+
+    /**
+     * Write the image for bits. The image is written to a temporary file of this
+     * process first and then renamed, so other runs never see a partial image.
+     * @param bits Bit string of the bitvector
+     * @param bitvector Bitvector built from bits
+     * @return Whether the image was written
+     */
+    bool store(const std::string& bits, const Bitvector& bitvector) const;
+
+    /**
+     * Get the path of the image for bits
+     */
+    std::string imagePath(const std::string& bits) const;
+
+    /**
+     * Fast 64-bit hash of a string, reads eight bytes at a time
+     */
+    static uint64_t hash(const std::string& bits);
+
+private:
+    std::string directory;
+};
+
+
+#endif //BITVECTOR_INDEX_CACHE_HPP
@@ -2,22 +2,49 @@
 #include <fstream>
 #include <string>
 #include <chrono>
+#include <cerrno>
+#include <cstdlib>
 #include <sstream>
 
 #include "bitvector.hpp"
+#include "index_cache.hpp"
+#include "query_executor.hpp"
 
 #define NAME "joshua_hauth"
 
 int main(int argc, char* argv[]) {
     // Check for valid input
     if ( argc < 3) {
-        std::cerr << "Usage: " << argv[0] << " <inputFilename> <outputFilename>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <inputFilename> <outputFilename> [--threads <n>] [--cache-dir <dir>]" << std::endl;
         return 1;
     }
 
     std::string inputFile = argv[1];
     std::string outputFile = argv[2];
 
+    // Optional arguments
+    size_t numThreads = 0; //< 0 answers the commands in order on this thread
+    std::string cacheDir;  //< Empty disables the index cache
+    for (int i = 3; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            std::string value = argv[++i];
+            char* end = nullptr;
+            errno = 0;
+            numThreads = std::strtoul(value.c_str(), &end, 10);
+            if (value.empty() || value[0] == '-' || *end != '\0' || errno == ERANGE) {
+                std::cerr << "Invalid number of threads: " << value << std::endl;
+                std::cerr << "Usage: " << argv[0] << " <inputFilename> <outputFilename> [--threads <n>] [--cache-dir <dir>]" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--cache-dir" && i + 1 < argc) {
+            cacheDir = argv[++i];
+        } else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+    }
+
     std::ifstream input(inputFile);
     std::ofstream output(outputFile);
 
@@ -48,7 +75,30 @@ int main(int argc, char* argv[]) {
 
     // Init bitvector
     std::getline(input, line);
-    Bitvector bitvector(line);
+    std::unique_ptr<Bitvector> index;
+    if (cacheDir.empty()) {
+        index.reset(new Bitvector(line));
+    } else {
+        bool cached;
+        IndexCache cache(cacheDir);
+        index = cache.getOrBuild(line, cached);
+        std::cerr << (cached ? "Read index from " : "Built index for ") << cache.imagePath(line) << std::endl;
+    }
+    Bitvector& bitvector = *index;
+
+    if (numThreads > 0) {
+        // Parallel mode: no per command timing, only the total
+        start = std::chrono::high_resolution_clock::now();
+        QueryExecutor executor(bitvector, numThreads);
+        size_t answered = executor.run(input, output, numCommands);
+        end = std::chrono::high_resolution_clock::now();
+        timeInMS = end - start;
+
+        printf("commands=%zu name=%s time=%f space=%zu\n", answered, NAME, timeInMS.count(), bitvector.getSpace());
+        input.close();
+        output.close();
+        return 0;
+    }
 
     // Execute commands
     while (numCommands-- > 0 && std::getline(input, line)) {
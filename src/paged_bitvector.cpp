@@ -0,0 +1,224 @@
+#include "paged_bitvector.hpp"
+#include "word_ops.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const size_t PagedBitvector::blockBits;
+const size_t PagedBitvector::superblockBits;
+const size_t PagedBitvector::selectSampleRate;
+
+const uint64_t pagedMagic = 0x3130304750564221; //< "!BVPG001"
+const size_t pagedHeaderBytes = 2 * sizeof(uint64_t);
+
+bool PagedBitvector::writeFile(std::istream& bits, const std::string& path) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open()) return false;
+
+    // Size is only known at the end, write the header again then
+    uint64_t header[2] = {pagedMagic, 0};
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    std::vector<uint64_t> buffer;
+    buffer.reserve(1 << 13);
+    uint64_t word = 0;
+    uint64_t size = 0;
+    for (int c = bits.get(); c == '0' || c == '1'; c = bits.get()) {
+        if (c == '1') word |= static_cast<uint64_t>(1) << (size % 64);
+        if (++size % 64 == 0) {
+            buffer.push_back(word);
+            word = 0;
+            if (buffer.size() == buffer.capacity()) {
+                out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(uint64_t));
+                buffer.clear();
+            }
+        }
+    }
+    if (size % 64 != 0) buffer.push_back(word);
+    out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(uint64_t));
+
+    header[1] = size;
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    return static_cast<bool>(out);
+}
+
+std::unique_ptr<PagedBitvector> PagedBitvector::open(const std::string& path, size_t chunkWords, size_t maxChunks) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+
+    // The file must hold exactly the words for the size in the header,
+    // otherwise the directories would be sized from a broken header
+    uint64_t header[2];
+    struct stat status;
+    if (pread(fd, header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) || header[0] != pagedMagic
+        || fstat(fd, &status) != 0
+        || static_cast<uint64_t>(status.st_size) != pagedHeaderBytes + (header[1] / 64 + (header[1] % 64 == 0 ? 0 : 1)) * 8) {
+        close(fd);
+        return nullptr;
+    }
+
+    std::unique_ptr<PagedBitvector> bv(new PagedBitvector(fd, header[1], chunkWords, maxChunks));
+    if (!bv->buildDirectories()) return nullptr;
+    return bv;
+}
+
+PagedBitvector::PagedBitvector(int fd, size_t size, size_t chunkWords, size_t maxChunks)
+: fd(fd),
+  size(size),
+  numWords(size / 64 + (size % 64 == 0 ? 0 : 1)),
+  chunkWords(std::max((chunkWords + blockBits / 64 - 1) / (blockBits / 64), static_cast<size_t>(1)) * (blockBits / 64)),
+  maxChunks(std::max(maxChunks, static_cast<size_t>(1))),
+  chunkReads(0),
+  rankSuperblocks(size / superblockBits + 1),
+  rankBlocks(size / blockBits + 1) {}
+
+PagedBitvector::~PagedBitvector() {
+    close(fd);
+}
+
+bool PagedBitvector::readWords(size_t first, size_t count, uint64_t* out) const {
+    size_t bytes = count * sizeof(uint64_t);
+    off_t offset = static_cast<off_t>(pagedHeaderBytes + first * sizeof(uint64_t));
+    char* target = reinterpret_cast<char*>(out);
+    while (bytes > 0) {
+        ssize_t n = pread(fd, target, bytes, offset);
+        if (n <= 0) return false;
+        target += n;
+        bytes -= static_cast<size_t>(n);
+        offset += n;
+    }
+    return true;
+}
+
+bool PagedBitvector::buildDirectories() {
+    // One pass over the file, chunk by chunk without going through the pool
+    std::vector<uint64_t> buffer(chunkWords);
+    size_t wordsPerBlock = blockBits / 64;
+    size_t ones = 0;
+    size_t nextSample[2] = {1, 1};
+
+    for (size_t block = 0; block < rankBlocks.size(); ++block) {
+        size_t firstWord = block * wordsPerBlock;
+        if (firstWord % chunkWords == 0 && firstWord < numWords) {
+            size_t count = std::min(chunkWords, numWords - firstWord);
+            if (!readWords(firstWord, count, buffer.data())) return false;
+        }
+        if (block * blockBits % superblockBits == 0) {
+            rankSuperblocks[block * blockBits / superblockBits] = ones;
+        }
+        rankBlocks[block] = static_cast<uint16_t>(ones - rankSuperblocks[block * blockBits / superblockBits]);
+
+        size_t blockOnes = 0;
+        for (size_t w = firstWord; w < firstWord + wordsPerBlock && w < numWords; ++w) {
+            blockOnes += popcount64(buffer[w % chunkWords]);
+        }
+        size_t onesAfter = ones + blockOnes;
+        size_t zerosAfter = std::min(size, (block + 1) * blockBits) - onesAfter;
+
+        // Remember the block of every selectSampleRate-th zero and one
+        for (; nextSample[1] <= onesAfter; nextSample[1] += selectSampleRate) selectSamples[1].push_back(block);
+        for (; nextSample[0] <= zerosAfter; nextSample[0] += selectSampleRate) selectSamples[0].push_back(block);
+
+        ones = onesAfter;
+    }
+    return true;
+}
+
+const uint64_t* PagedBitvector::chunk(size_t index) {
+    auto it = chunks.find(index);
+    if (it != chunks.end()) {
+        lru.splice(lru.begin(), lru, it->second.lruPosition);
+        return it->second.words.data();
+    }
+
+    // Reuse the buffer of the least recently used chunk if the pool is full
+    std::vector<uint64_t> words;
+    if (chunks.size() >= maxChunks) {
+        auto victim = chunks.find(lru.back());
+        words.swap(victim->second.words);
+        chunks.erase(victim);
+        lru.pop_back();
+    }
+    words.assign(chunkWords, 0);
+    size_t first = index * chunkWords;
+    if (first < numWords && !readWords(first, std::min(chunkWords, numWords - first), words.data())) {
+        throw std::runtime_error("PagedBitvector: failed to read chunk " + std::to_string(index));
+    }
+    ++chunkReads;
+
+    lru.push_front(index);
+    Chunk& entry = chunks[index];
+    entry.words.swap(words);
+    entry.lruPosition = lru.begin();
+    return entry.words.data();
+}
+
+const uint64_t* PagedBitvector::blockWords(size_t block) {
+    size_t firstWord = block * (blockBits / 64);
+    return chunk(firstWord / chunkWords) + firstWord % chunkWords;
+}
+
+size_t PagedBitvector::getSize() const {
+    return size;
+}
+
+bool PagedBitvector::access(size_t i) {
+    const uint64_t* words = blockWords(i / blockBits);
+    return (words[(i % blockBits) / 64] >> (i % 64)) & 1;
+}
+
+size_t PagedBitvector::rank(bool bit, size_t i) {
+    size_t ones = blockCount(i / blockBits, true);
+    if (i % blockBits != 0) {
+        const uint64_t* words = blockWords(i / blockBits);
+        size_t word = (i % blockBits) / 64;
+        for (size_t k = 0; k < word; ++k) {
+            ones += popcount64(words[k]);
+        }
+        ones += popcount64(words[word] & lowerBits(i % 64));
+    }
+    return bit ? ones : i - ones;
+}
+
+size_t PagedBitvector::select(bool bit, size_t n) {
+    // The samples bound the search to the blocks between two of them
+    const std::vector<uint64_t>& samples = selectSamples[bit];
+    size_t sample = (n - 1) / selectSampleRate;
+    size_t lo = samples[sample];
+    size_t hi = sample + 1 < samples.size() ? samples[sample + 1] + 1 : rankBlocks.size();
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (blockCount(mid, bit) < n) lo = mid;
+        else hi = mid;
+    }
+
+    const uint64_t* words = blockWords(lo);
+    size_t before = blockCount(lo, bit);
+    for (size_t k = 0; k < blockBits / 64; ++k) {
+        uint64_t pattern = bit ? words[k] : ~words[k];
+        size_t count = popcount64(pattern);
+        if (before + count >= n) {
+            return lo * blockBits + k * 64 + selectInWord(pattern, n - before - 1);
+        }
+        before += count;
+    }
+    throw std::runtime_error("PagedBitvector: file does not match the directories");
+}
+
+size_t PagedBitvector::getChunkReads() const {
+    return chunkReads;
+}
+
+size_t PagedBitvector::getSpace() const {
+    size_t bytes = sizeof(*this)
+            + rankSuperblocks.size() * sizeof(uint64_t)
+            + rankBlocks.size() * sizeof(uint16_t)
+            + (selectSamples[0].size() + selectSamples[1].size()) * sizeof(uint64_t)
+            + chunks.size() * chunkWords * sizeof(uint64_t);
+    return bytes * 8;
+}
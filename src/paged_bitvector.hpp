@@ -0,0 +1,141 @@
+#ifndef BITVECTOR_PAGED_BITVECTOR_HPP
+#define BITVECTOR_PAGED_BITVECTOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Bitvector that stays on disk. Only the rank and select directories are
+ * resident, the packed words are read in chunks into a bounded LRU pool.
+ *
+ * A block of 512 bits never spans two chunks, so rank reads at most one
+ * chunk and none at the start of a block. Select samples every 8192-th bit,
+ * searches the resident directories and then reads one chunk.
+ *
+ * If the file cannot be read any more after opening, access, rank and select
+ * throw std::runtime_error. The pool stays usable for later queries.
+ */
+class PagedBitvector {
+public:
+    /**
+     * Convert a bit string into the file format of the paged bitvector.
+     * Reads '0' and '1' until the end of the line, so the bits never have to fit into memory.
+     * @param bits Stream positioned at the bits
+     * @param path File to write
+     * @return Whether the file was written
+     */
+    static bool writeFile(std::istream& bits, const std::string& path);
+
+    /**
+     * Open a file written by writeFile and build the directories in one pass over it.
+     * The file must hold exactly the words for the size in its header.
+     * @param path File to read
+     * @param chunkWords Number of 64-bit words per chunk, rounded up to whole blocks
+     * @param maxChunks Maximum number of chunks in memory, at least one
+     * @return The bitvector or nullptr if the file cannot be read
+     */
+    static std::unique_ptr<PagedBitvector> open(const std::string& path, size_t chunkWords = 1 << 13,
+                                                size_t maxChunks = 64);
+
+    ~PagedBitvector();
+
+    PagedBitvector(const PagedBitvector&) = delete;
+    PagedBitvector& operator=(const PagedBitvector&) = delete;
+
+    /**
+     * Get the size of the bitvector
+     * @return Size of bitvector
+     */
+    size_t getSize() const;
+
+    /**
+     * Access the bit a specific index.
+     * Undefined behaviour for out-of-range access
+     * @throws std::runtime_error if the file cannot be read
+     */
+    bool access(size_t i);
+
+    /**
+     * Get the number of bits bit before index i.
+     * Valid for 0 <= i <= getSize()
+     * @throws std::runtime_error if the file cannot be read
+     */
+    size_t rank(bool bit, size_t i);
+
+    /**
+     * Get the position of the n-th bit of type bit.
+     * Assumes that there is actually a position!
+     * @throws std::runtime_error if the file cannot be read
+     */
+    size_t select(bool bit, size_t n);
+
+    /**
+     * Number of chunks read from the file since opening
+     */
+    size_t getChunkReads() const;
+
+    /**
+     * Returns the resident size, directories and chunks in memory
+     * @return size in bits
+     */
+    size_t getSpace() const;
+
+private:
+    static const size_t blockBits = 512;           //< Bits per rank block
+    static const size_t superblockBits = 1 << 16;  //< Bits per rank superblock
+    static const size_t selectSampleRate = 8192;   //< Bits of one kind between select samples
+
+    struct Chunk {
+        std::vector<uint64_t> words;
+        std::list<size_t>::iterator lruPosition;
+    };
+
+    PagedBitvector(int fd, size_t size, size_t chunkWords, size_t maxChunks);
+
+    /**
+     * Build the rank and select directories from the file
+     * @return Whether the file could be read
+     */
+    bool buildDirectories();
+
+    /**
+     * Read count words starting at word first from the file
+     */
+    bool readWords(size_t first, size_t count, uint64_t* out) const;
+
+    /**
+     * Get the words of a chunk, read it if it is not in the pool
+     */
+    const uint64_t* chunk(size_t index);
+
+    /**
+     * Get the words of the block, at most blockBits / 64 of them are valid
+     */
+    const uint64_t* blockWords(size_t block);
+
+    size_t blockCount(size_t block, bool bit) const {
+        size_t ones = rankSuperblocks[block * blockBits / superblockBits] + rankBlocks[block];
+        return bit ? ones : block * blockBits - ones;
+    }
+
+    int fd;                                         //< File with the packed words
+    size_t size;                                    //< Number of bits
+    size_t numWords;                                //< Number of packed words in the file
+    size_t chunkWords;                              //< Words per chunk, multiple of the block words
+    size_t maxChunks;                               //< Capacity of the pool
+    size_t chunkReads;                              //< Chunks read since opening
+    std::vector<uint64_t> rankSuperblocks;          //< Ones before each superblock
+    std::vector<uint16_t> rankBlocks;               //< Ones before each block within its superblock
+    std::vector<uint64_t> selectSamples[2];         //< Block of every selectSampleRate-th zero / one
+    std::unordered_map<size_t, Chunk> chunks;       //< Pool of chunks in memory
+    std::list<size_t> lru;                          //< Chunk indices, most recently used first
+};
+
+
+#endif //BITVECTOR_PAGED_BITVECTOR_HPP
@@ -0,0 +1,232 @@
+#include "query_executor.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+/**
+ * Skip spaces and tabs, but stop at the end of the line
+ */
+const char* skipSpaces(const char* pos, const char* end) {
+    while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r')) ++pos;
+    return pos;
+}
+
+/**
+ * Parse an unsigned number. Leaves value at 0 if there is none
+ */
+const char* parseNumber(const char* pos, const char* end, size_t& value) {
+    pos = skipSpaces(pos, end);
+    value = 0;
+    while (pos < end && *pos >= '0' && *pos <= '9') {
+        value = value * 10 + static_cast<size_t>(*pos - '0');
+        ++pos;
+    }
+    return pos;
+}
+
+/**
+ * Append a number and a newline without going through a stream
+ */
+void appendNumber(std::string& out, size_t value) {
+    char digits[20];
+    size_t n = 0;
+    do {
+        digits[n++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value);
+    while (n > 0) out.push_back(digits[--n]);
+    out.push_back('\n');
+}
+
+/**
+ * Cut text after the maxLines-th line
+ * @return Number of lines left in text
+ */
+size_t limitLines(std::string& text, size_t maxLines) {
+    size_t lines = 0;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        if (lines == maxLines) {
+            text.resize(pos);
+            break;
+        }
+        const void* newline = memchr(&text[pos], '\n', text.size() - pos);
+        pos = newline ? static_cast<const char*>(newline) - text.data() + 1 : text.size();
+        ++lines;
+    }
+    return lines;
+}
+
+QueryExecutor::QueryExecutor(Bitvector& bitvector, size_t numThreads, size_t chunkSize)
+: bitvector(bitvector),
+  numThreads(std::max(numThreads, static_cast<size_t>(1))),
+  chunkSize(std::max(chunkSize, static_cast<size_t>(1))),
+  maxChunksInFlight(4 * this->numThreads),
+  queues(this->numThreads),
+  queued(0),
+  finishedReading(false) {}
+
+void QueryExecutor::process(Chunk& chunk) {
+    // Chunks are mostly consecutive lines of a sorted file, so cursors keep the queries local
+    Bitvector::Cursor rankCursor;
+    Bitvector::Cursor selectCursors[2];
+
+    const char* pos = chunk.commands.data();
+    const char* end = pos + chunk.commands.size();
+    while (pos < end) {
+        const char* lineEnd = static_cast<const char*>(memchr(pos, '\n', end - pos));
+        if (!lineEnd) lineEnd = end;
+
+        pos = skipSpaces(pos, lineEnd);
+        const char* command = pos;
+        while (pos < lineEnd && *pos != ' ' && *pos != '\t' && *pos != '\r') ++pos;
+        size_t commandLength = pos - command;
+
+        size_t type, index;
+        if (commandLength == 6 && memcmp(command, "access", 6) == 0) {
+            parseNumber(pos, lineEnd, index);
+            appendNumber(chunk.results, bitvector.access(index));
+        } else if (commandLength == 4 && memcmp(command, "rank", 4) == 0) {
+            parseNumber(parseNumber(pos, lineEnd, type), lineEnd, index);
+            appendNumber(chunk.results, bitvector.rank(type, index, rankCursor));
+        } else if (commandLength == 6 && memcmp(command, "select", 6) == 0) {
+            parseNumber(parseNumber(pos, lineEnd, type), lineEnd, index);
+            appendNumber(chunk.results, bitvector.select(type, index, selectCursors[type != 0]));
+        } else {
+            std::cerr << "Unknown command: " << std::string(command, commandLength) << "\n";
+            chunk.results += "NaN\n";
+        }
+        pos = lineEnd < end ? lineEnd + 1 : end;
+    }
+}
+
+std::shared_ptr<QueryExecutor::Chunk> QueryExecutor::take(size_t worker) {
+    std::shared_ptr<Chunk> chunk;
+    {
+        // Own queue from the front, so older chunks are answered first
+        std::lock_guard<std::mutex> lock(queues[worker].mutex);
+        if (!queues[worker].chunks.empty()) {
+            chunk = queues[worker].chunks.front();
+            queues[worker].chunks.pop_front();
+        }
+    }
+    // Steal from the back of the other queues
+    for (size_t k = 1; !chunk && k < numThreads; ++k) {
+        WorkQueue& victim = queues[(worker + k) % numThreads];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.chunks.empty()) {
+            chunk = victim.chunks.back();
+            victim.chunks.pop_back();
+        }
+    }
+    if (chunk) {
+        std::lock_guard<std::mutex> lock(mutex);
+        --queued;
+    }
+    return chunk;
+}
+
+void QueryExecutor::work(size_t worker) {
+    while (true) {
+        std::shared_ptr<Chunk> chunk = take(worker);
+        if (!chunk) {
+            std::unique_lock<std::mutex> lock(mutex);
+            workAvailable.wait(lock, [this] { return queued > 0 || finishedReading; });
+            if (queued == 0 && finishedReading) return;
+            continue;
+        }
+
+        process(*chunk);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        chunk->done = true;
+        chunkDone.notify_all();
+    }
+}
+
+void QueryExecutor::write(std::ostream& output) {
+    while (true) {
+        std::shared_ptr<Chunk> chunk;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            chunkDone.wait(lock, [this] {
+                return (!pending.empty() && pending.front()->done) || (pending.empty() && finishedReading);
+            });
+            if (pending.empty()) return;
+            chunk = pending.front();
+            pending.pop_front();
+            spaceAvailable.notify_one();
+        }
+        output.write(chunk->results.data(), static_cast<std::streamsize>(chunk->results.size()));
+    }
+}
+
+size_t QueryExecutor::run(std::istream& input, std::ostream& output, size_t numCommands) {
+    queued = 0;
+    finishedReading = false;
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < numThreads; ++i) {
+        workers.emplace_back(&QueryExecutor::work, this, i);
+    }
+    std::thread writer(&QueryExecutor::write, this, std::ref(output));
+
+    // Read chunks of complete lines while the workers answer the previous ones
+    size_t commandsLeft = numCommands;
+    size_t nextQueue = 0;
+    std::string carry;
+    while (commandsLeft > 0) {
+        auto chunk = std::make_shared<Chunk>();
+        chunk->commands.swap(carry);
+        size_t old = chunk->commands.size();
+        chunk->commands.resize(old + chunkSize);
+        input.read(&chunk->commands[old], static_cast<std::streamsize>(chunkSize));
+        chunk->commands.resize(old + static_cast<size_t>(input.gcount()));
+        bool eof = !input;
+
+        if (!eof) {
+            size_t lastLine = chunk->commands.rfind('\n');
+            if (lastLine == std::string::npos) {
+                // Line longer than a chunk, keep reading
+                carry.swap(chunk->commands);
+                continue;
+            }
+            carry.assign(chunk->commands, lastLine + 1, std::string::npos);
+            chunk->commands.resize(lastLine + 1);
+        }
+        commandsLeft -= limitLines(chunk->commands, commandsLeft);
+
+        if (!chunk->commands.empty()) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                spaceAvailable.wait(lock, [this] { return pending.size() < maxChunksInFlight; });
+                pending.push_back(chunk);
+            }
+            {
+                // Count and publish together, so a worker never takes a chunk that is not counted yet
+                std::lock_guard<std::mutex> lock(mutex);
+                std::lock_guard<std::mutex> queueLock(queues[nextQueue].mutex);
+                ++queued;
+                queues[nextQueue].chunks.push_back(chunk);
+            }
+            nextQueue = (nextQueue + 1) % numThreads;
+            workAvailable.notify_one();
+        }
+        if (eof) break;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finishedReading = true;
+    }
+    workAvailable.notify_all();
+    chunkDone.notify_all();
+
+    for (auto& worker : workers) worker.join();
+    writer.join();
+    output.flush();
+
+    return numCommands - commandsLeft;
+}
@@ -0,0 +1,83 @@
+#ifndef BITVECTOR_QUERY_EXECUTOR_HPP
+#define BITVECTOR_QUERY_EXECUTOR_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "bitvector.hpp"
+
+/**
+ * Answers access, rank and select commands on a pool of threads.
+ * The command file is read in large chunks while earlier chunks are answered.
+ * Every worker has its own queue of chunks and steals from the others when it runs dry.
+ * Results are written in input order with buffered writes.
+ */
+class QueryExecutor {
+public:
+    /**
+     * @param bitvector Bitvector to query. Only read, so it can be shared by the workers
+     * @param numThreads Number of worker threads, at least one
+     * @param chunkSize Approximate number of bytes of the command file per chunk
+     */
+    QueryExecutor(Bitvector& bitvector, size_t numThreads, size_t chunkSize = 1 << 20);
+
+    /**
+     * Answer up to numCommands commands, one per line, and write one result per line.
+     * Unknown commands are answered with NaN.
+     * @param input Stream positioned at the first command
+     * @param output Stream for the results
+     * @param numCommands Maximum number of commands to answer
+     * @return Number of answered commands
+     */
+    size_t run(std::istream& input, std::ostream& output, size_t numCommands);
+
+private:
+    struct Chunk {
+        std::string commands;   //< Complete lines of the command file
+        std::string results;    //< One line per command
+        bool done = false;      //< Results are ready to be written
+    };
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::shared_ptr<Chunk>> chunks;
+    };
+
+    /**
+     * Answer all commands in a chunk
+     */
+    void process(Chunk& chunk);
+
+    /**
+     * Take a chunk from the own queue or steal one from the other workers
+     * @param worker Index of the worker
+     * @return The chunk or nullptr if all queues are empty
+     */
+    std::shared_ptr<Chunk> take(size_t worker);
+
+    void work(size_t worker);
+
+    void write(std::ostream& output);
+
+    Bitvector& bitvector;
+    size_t numThreads;
+    size_t chunkSize;
+    size_t maxChunksInFlight;                       //< Bounds memory if reading is faster than answering
+    std::vector<WorkQueue> queues;                  //< One queue per worker
+    std::mutex mutex;                               //< Guards everything below
+    std::condition_variable workAvailable;
+    std::condition_variable chunkDone;
+    std::condition_variable spaceAvailable;
+    std::deque<std::shared_ptr<Chunk>> pending;     //< Chunks not written yet, in input order
+    size_t queued;                                  //< Chunks in queues not taken by a worker
+    bool finishedReading;
+};
+
+
+#endif //BITVECTOR_QUERY_EXECUTOR_HPP
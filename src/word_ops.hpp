@@ -0,0 +1,67 @@
+#ifndef BITVECTOR_WORD_OPS_HPP
+#define BITVECTOR_WORD_OPS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Operations on single 64-bit words shared by the bitvector engines.
+ * Bit i of a word is position i, so lower bits come first.
+ */
+
+/**
+ * Get the number of one bits in a word
+ */
+inline uint8_t popcount64(uint64_t n) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<uint8_t>(__builtin_popcountll(n));
+#else
+    uint8_t count = 0;
+    while (n) {
+        n &= (n - 1);
+        count++;
+    }
+    return count;
+#endif
+}
+
+/**
+ * Get the position of the k-th (starting at 0) one bit in a word.
+ * Assumes the word has more than k ones.
+ */
+inline size_t selectInWord(uint64_t n, size_t k) {
+    for (size_t j = 0; j < k; ++j) {
+        n &= (n - 1);
+    }
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<size_t>(__builtin_ctzll(n));
+#else
+    size_t pos = 0;
+    while (!(n & 1)) {
+        n >>= 1;
+        ++pos;
+    }
+    return pos;
+#endif
+}
+
+/**
+ * Mask for the bits before position i within a word
+ */
+inline uint64_t lowerBits(size_t i) {
+    return i == 0 ? 0 : (~static_cast<uint64_t>(0) >> (64 - i));
+}
+
+/**
+ * Hint that a word will be read soon
+ */
+inline void prefetchWord(const uint64_t* word) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(word);
+#else
+    (void) word;
+#endif
+}
+
+
+#endif //BITVECTOR_WORD_OPS_HPP
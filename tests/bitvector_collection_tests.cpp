@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include <random>
+
+#include "../src/bitvector_collection.hpp"
+
+/**
+ * Random bit strings of different sizes and densities
+ */
+std::vector<std::string> generateBitStrings(size_t count, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<std::string> result;
+    for (size_t k = 0; k < count; ++k) {
+        size_t size = 1 + rng() % 3000;
+        size_t density = rng() % 10;
+        std::string bits(size, '0');
+        for (auto& c : bits) c = rng() % 10 < density ? '1' : '0';
+        result.push_back(bits);
+    }
+    return result;
+}
+
+/**
+ * Compare access, rank and select of every bitvector with the strings
+ */
+TEST(BitvectorCollection, SingleQueries) {
+    auto strings = generateBitStrings(50, 1);
+    strings.push_back(std::string(512, '1'));
+    strings.push_back(std::string(1024, '0'));
+    BitvectorCollection collection;
+    for (auto& bits : strings) collection.add(bits);
+    ASSERT_EQ(collection.count(), strings.size());
+
+    for (size_t id = 0; id < strings.size(); ++id) {
+        const std::string& bits = strings[id];
+        EXPECT_EQ(collection.getSize(id), bits.size());
+        size_t ones = 0;
+        for (size_t i = 0; i <= bits.size(); ++i) {
+            EXPECT_EQ(collection.rank(id, 1, i), ones);
+            EXPECT_EQ(collection.rank(id, 0, i), i - ones);
+            if (i == bits.size()) break;
+
+            EXPECT_EQ(collection.access(id, i), bits[i] == '1');
+            if (bits[i] == '1') {
+                ++ones;
+                EXPECT_EQ(collection.select(id, 1, ones), i);
+            } else {
+                EXPECT_EQ(collection.select(id, 0, i + 1 - ones), i);
+            }
+        }
+    }
+}
+
+/**
+ * Batched queries give the same answers as single ones
+ */
+TEST(BitvectorCollection, BatchedQueries) {
+    auto strings = generateBitStrings(40, 2);
+    for (auto& bits : strings) bits = std::string(2000, '1') + bits;
+    BitvectorCollection collection;
+    for (auto& bits : strings) collection.add(bits);
+
+    std::vector<size_t> ids = {3, 0, 17, 39, 17, 8};
+    std::vector<size_t> out;
+    for (size_t i : {0, 1, 511, 512, 1999, 2000}) {
+        collection.rankMany(ids, 1, i, out);
+        ASSERT_EQ(out.size(), ids.size());
+        for (size_t k = 0; k < ids.size(); ++k) {
+            EXPECT_EQ(out[k], collection.rank(ids[k], 1, i));
+        }
+        collection.rankMany(ids, 0, i, out);
+        for (size_t k = 0; k < ids.size(); ++k) {
+            EXPECT_EQ(out[k], collection.rank(ids[k], 0, i));
+        }
+    }
+    for (size_t n : {1, 64, 513, 2000}) {
+        collection.selectMany(ids, 1, n, out);
+        ASSERT_EQ(out.size(), ids.size());
+        for (size_t k = 0; k < ids.size(); ++k) {
+            EXPECT_EQ(out[k], collection.select(ids[k], 1, n));
+        }
+    }
+}
@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <sstream>
 
 #include "../src/bitvector.hpp"
 
@@ -310,3 +313,210 @@ TEST(Select, BlockBetween64) {}
  * Test select on last unfilled block
  */
 TEST(Select, EndBlock) {}
+
+/**
+ * Compare cursor rank with plain rank on increasing indices
+ */
+TEST(Cursor, RankIncreasing) {
+    std::string bits = generateBitString("1101000111010", 5000);
+    Bitvector bv(bits);
+    Bitvector::Cursor cursor;
+
+    size_t ones = 0;
+    for (size_t i = 0; i < bits.size(); ++i) {
+        EXPECT_EQ(bv.rank(1, i, cursor), ones);
+        EXPECT_EQ(bv.rank(0, i, cursor), i - ones);
+        if (bits[i] == '1') ++ones;
+    }
+    EXPECT_EQ(bv.rank(1, bits.size(), cursor), ones);
+}
+
+/**
+ * Cursor rank with jumps forwards and backwards
+ */
+TEST(Cursor, RankJumps) {
+    std::string bits = generateBitString("100110", 4096);
+    Bitvector bv(bits);
+    Bitvector::Cursor cursor;
+
+    for (size_t i : {4000, 10, 11, 2000, 2064, 3000, 64, 0, 4096}) {
+        size_t ones = std::count(bits.begin(), bits.begin() + i, '1');
+        EXPECT_EQ(bv.rank(1, i, cursor), ones);
+        EXPECT_EQ(bv.rank(0, i, cursor), i - ones);
+    }
+}
+
+/**
+ * Compare cursor select with a naive scan for every one and zero in order
+ */
+TEST(Cursor, SelectIncreasing) {
+    std::string bits = generateBitString("0010111010000000011", 10000);
+    Bitvector bv(bits);
+    Bitvector::Cursor oneCursor;
+    Bitvector::Cursor zeroCursor;
+
+    size_t ones = 0;
+    size_t zeros = 0;
+    for (size_t i = 0; i < bits.size(); ++i) {
+        if (bits[i] == '1') {
+            EXPECT_EQ(bv.select(1, ++ones, oneCursor), i);
+        } else {
+            EXPECT_EQ(bv.select(0, ++zeros, zeroCursor), i);
+        }
+    }
+}
+
+/**
+ * Cursor select with large gaps, jumps backwards and a long run of zeros
+ */
+TEST(Cursor, SelectJumps) {
+    std::string bits = generateBitString("0", 50000) + "1" + generateBitString("10", 3000) + "1";
+    Bitvector bv(bits);
+    Bitvector::Cursor cursor;
+
+    std::vector<size_t> positions;
+    for (size_t i = 0; i < bits.size(); ++i) {
+        if (bits[i] == '1') positions.push_back(i);
+    }
+    for (size_t n : {1, 2, 1500, 3, 1502, 1000, 1502, 1}) {
+        EXPECT_EQ(bv.select(1, n, cursor), positions[n - 1]);
+    }
+    EXPECT_EQ(bv.select(0, 1, cursor), 0);
+    EXPECT_EQ(bv.select(0, 50000, cursor), 49999);
+    EXPECT_EQ(bv.select(0, 50001, cursor), 50002);
+}
+
+/**
+ * Count ones in short ranges within a word and long ranges over many blocks
+ */
+TEST(Range, CountOnes) {
+    std::string bits = generateBitString("1110010", 3000);
+    Bitvector bv(bits);
+
+    for (size_t l : {0, 1, 63, 64, 100, 1000, 2999, 3000}) {
+        for (size_t r : {l, l + 1, l + 63, l + 64, l + 700, static_cast<size_t>(3000)}) {
+            if (r < l || r > bits.size()) continue;
+            size_t expected = std::count(bits.begin() + l, bits.begin() + r, '1');
+            EXPECT_EQ(bv.countOnes(l, r), expected);
+        }
+    }
+}
+
+/**
+ * Select the n-th one or zero at or after a position
+ */
+TEST(Range, SelectFrom) {
+    std::string bits = generateBitString("0001101", 3000);
+    Bitvector bv(bits);
+
+    for (size_t l : {0, 5, 64, 65, 1000, 2900}) {
+        for (size_t n : {1, 2, 10, 30}) {
+            size_t expectedOne = l;
+            size_t expectedZero = l;
+            for (size_t seen = 0; seen < n; ++expectedOne) {
+                if (bits[expectedOne] == '1' && ++seen == n) break;
+            }
+            for (size_t seen = 0; seen < n; ++expectedZero) {
+                if (bits[expectedZero] == '0' && ++seen == n) break;
+            }
+            EXPECT_EQ(bv.selectFrom(1, l, n), expectedOne);
+            EXPECT_EQ(bv.selectFrom(0, l, n), expectedZero);
+        }
+    }
+}
+
+/**
+ * Export all prefix ranks, including the one after the last bit
+ */
+TEST(Range, ExportRanks) {
+    for (size_t size : {1, 64, 129}) {
+        std::string bits = generateBitString("10110", size);
+        Bitvector bv(bits);
+
+        std::vector<uint32_t> ranks32(size + 1);
+        std::vector<uint64_t> ranks64(size + 1);
+        bv.exportRanks(ranks32.data(), ranks32.size());
+        bv.exportRanks(ranks64.data(), ranks64.size());
+
+        size_t ones = 0;
+        for (size_t i = 0; i <= size; ++i) {
+            EXPECT_EQ(ranks32[i], ones);
+            EXPECT_EQ(ranks64[i], ones);
+            if (i < size && bits[i] == '1') ++ones;
+        }
+    }
+}
+
+/**
+ * A bitvector read from its image answers like the original
+ */
+TEST(Image, RoundTrip) {
+    std::string bits = generateBitString("0", 3000) + generateBitString("1101001", 5000);
+    Bitvector bv(bits);
+    std::stringstream image;
+    ASSERT_TRUE(bv.writeImage(image));
+
+    auto copy = Bitvector::readImage(image, bits.size());
+    ASSERT_NE(copy, nullptr);
+    EXPECT_EQ(copy->getSize(), bits.size());
+    for (size_t i = 0; i < bits.size(); i += 7) {
+        EXPECT_EQ(copy->access(i), bv.access(i));
+        EXPECT_EQ(copy->rank(1, i), bv.rank(1, i));
+        EXPECT_EQ(copy->rank(0, i), bv.rank(0, i));
+    }
+    Bitvector::Cursor cursor;
+    Bitvector::Cursor copyCursor;
+    for (size_t n = 1; n < 2800; n += 13) {
+        EXPECT_EQ(copy->select(1, n, copyCursor), bv.select(1, n, cursor));
+    }
+
+    // Writing the copy again gives the same bytes, so the select superblocks survived too
+    std::stringstream again;
+    ASSERT_TRUE(copy->writeImage(again));
+    EXPECT_EQ(again.str(), image.str());
+}
+
+/**
+ * Broken images are rejected instead of read
+ */
+TEST(Image, Invalid) {
+    std::string bits = generateBitString("10", 500);
+    Bitvector bv(bits);
+    std::stringstream image;
+    ASSERT_TRUE(bv.writeImage(image));
+    std::string data = image.str();
+
+    // Overwrite the 64-bit field at offset with value
+    auto patched = [&](size_t offset, uint64_t value) {
+        std::string copy = data;
+        memcpy(&copy[offset], &value, sizeof(value));
+        return copy;
+    };
+
+    std::stringstream truncated(data.substr(0, data.size() / 2));
+    EXPECT_EQ(Bitvector::readImage(truncated, bits.size()), nullptr);
+
+    std::stringstream wrongMagic(patched(0, 0));
+    EXPECT_EQ(Bitvector::readImage(wrongMagic, bits.size()), nullptr);
+
+    std::stringstream wrongSize(data);
+    EXPECT_EQ(Bitvector::readImage(wrongSize, bits.size() + 1), nullptr);
+
+    // Header: magic, size, rankBlockSize, rankSuperblockSize, selectSBsize, selectBlockSize
+    std::stringstream bigRankBlocks(patched(16, 40));
+    EXPECT_EQ(Bitvector::readImage(bigRankBlocks, bits.size()), nullptr);
+
+    std::stringstream bigSelectBlocks(patched(40, uint64_t(1) << 40));
+    EXPECT_EQ(Bitvector::readImage(bigSelectBlocks, bits.size()), nullptr);
+
+    // Length of the words, then the first word
+    std::stringstream wrongLength(patched(48, 1000));
+    EXPECT_EQ(Bitvector::readImage(wrongLength, bits.size()), nullptr);
+
+    // Words that do not match the rank directories
+    std::stringstream wrongWords(patched(56, 0));
+    EXPECT_EQ(Bitvector::readImage(wrongWords, bits.size()), nullptr);
+
+    std::stringstream valid(data);
+    EXPECT_NE(Bitvector::readImage(valid, bits.size()), nullptr);
+}
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <stack>
+
+#include "../src/bp_tree.hpp"
+
+/**
+ * Generate a random tree with n nodes as balanced parentheses
+ */
+std::string generateTree(size_t n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::string bits;
+    size_t open = 0;
+    size_t left = n;
+    while (left > 0 || open > 0) {
+        // Keep a single root, so only close the root at the very end
+        bool canClose = open > 1 || (open == 1 && left == 0);
+        if (left > 0 && (open == 0 || !canClose || rng() % 2 == 0)) {
+            bits += '1';
+            ++open;
+            --left;
+        } else {
+            bits += '0';
+            --open;
+        }
+    }
+    return bits;
+}
+
+/**
+ * Naive navigation for comparison
+ */
+struct NaiveTree {
+    std::vector<size_t> match;
+    std::vector<size_t> parent;
+
+    explicit NaiveTree(const std::string& bits) : match(bits.size()), parent(bits.size(), BpTree::npos) {
+        std::stack<size_t> open;
+        for (size_t i = 0; i < bits.size(); ++i) {
+            if (bits[i] == '1') {
+                if (!open.empty()) parent[i] = open.top();
+                open.push(i);
+            } else {
+                match[i] = open.top();
+                match[open.top()] = i;
+                open.pop();
+            }
+        }
+    }
+
+    size_t lca(size_t i, size_t j) const {
+        std::vector<size_t> ancestors;
+        for (size_t k = i; k != BpTree::npos; k = parent[k]) ancestors.push_back(k);
+        for (size_t k = j; k != BpTree::npos; k = parent[k]) {
+            if (std::find(ancestors.begin(), ancestors.end(), k) != ancestors.end()) return k;
+        }
+        return BpTree::npos;
+    }
+};
+
+/**
+ * Compare every navigation operation with the naive tree on random trees
+ */
+TEST(BpTree, RandomTrees) {
+    for (size_t n : {1, 2, 31, 32, 33, 500, 5000}) {
+        std::string bits = generateTree(n, static_cast<unsigned>(n));
+        Bitvector bv(bits);
+        BpTree tree(bv);
+        NaiveTree naive(bits);
+
+        for (size_t i = 0; i < bits.size(); ++i) {
+            if (bits[i] == '0') {
+                EXPECT_EQ(tree.findOpen(i), naive.match[i]);
+                continue;
+            }
+            EXPECT_EQ(tree.findClose(i), naive.match[i]);
+            EXPECT_EQ(tree.enclose(i), naive.parent[i]);
+            EXPECT_EQ(tree.parent(i), naive.parent[i]);
+            EXPECT_EQ(tree.subtreeSize(i), (naive.match[i] - i + 1) / 2);
+
+            size_t child = bits[i + 1] == '1' ? i + 1 : BpTree::npos;
+            EXPECT_EQ(tree.firstChild(i), child);
+            size_t sibling = naive.match[i] + 1 < bits.size() && bits[naive.match[i] + 1] == '1'
+                    ? naive.match[i] + 1 : BpTree::npos;
+            EXPECT_EQ(tree.nextSibling(i), sibling);
+        }
+    }
+}
+
+/**
+ * Lowest common ancestors of random pairs, including ancestors of each other
+ */
+TEST(BpTree, Lca) {
+    std::string bits = generateTree(3000, 42);
+    Bitvector bv(bits);
+    BpTree tree(bv);
+    NaiveTree naive(bits);
+
+    std::vector<size_t> nodes;
+    for (size_t i = 0; i < bits.size(); ++i) {
+        if (bits[i] == '1') nodes.push_back(i);
+    }
+    std::mt19937 rng(7);
+    for (size_t k = 0; k < 2000; ++k) {
+        size_t i = nodes[rng() % nodes.size()];
+        size_t j = nodes[rng() % nodes.size()];
+        EXPECT_EQ(tree.lca(i, j), naive.lca(i, j));
+    }
+    EXPECT_EQ(tree.lca(nodes[5], nodes[5]), nodes[5]);
+    EXPECT_EQ(tree.lca(0, nodes.back()), 0);
+}
+
+/**
+ * A path and a star, the deepest and the flattest tree
+ */
+TEST(BpTree, PathAndStar) {
+    std::string path = std::string(1000, '1') + std::string(1000, '0');
+    Bitvector pathBv(path);
+    BpTree pathTree(pathBv);
+    EXPECT_EQ(pathTree.findClose(0), 1999);
+    EXPECT_EQ(pathTree.findClose(999), 1000);
+    EXPECT_EQ(pathTree.findOpen(1500), 499);
+    EXPECT_EQ(pathTree.parent(700), 699);
+    EXPECT_EQ(pathTree.parent(0), BpTree::npos);
+    EXPECT_EQ(pathTree.subtreeSize(10), 990);
+    EXPECT_EQ(pathTree.lca(300, 800), 300);
+    EXPECT_EQ(pathTree.nextSibling(300), BpTree::npos);
+
+    std::string star = "1";
+    for (size_t k = 0; k < 1000; ++k) star += "10";
+    star += "0";
+    Bitvector starBv(star);
+    BpTree starTree(starBv);
+    EXPECT_EQ(starTree.findClose(0), 2001);
+    EXPECT_EQ(starTree.subtreeSize(0), 1001);
+    EXPECT_EQ(starTree.parent(1999), 0);
+    EXPECT_EQ(starTree.nextSibling(1), 3);
+    EXPECT_EQ(starTree.firstChild(3), BpTree::npos);
+    EXPECT_EQ(starTree.lca(1, 1999), 0);
+}
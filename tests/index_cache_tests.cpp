@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+
+#include "../src/index_cache.hpp"
+
+/**
+ * The first lookup builds and stores the image, the second one reads it
+ */
+TEST(IndexCache, BuildThenRead) {
+    std::string bits;
+    for (size_t i = 0; i < 4000; ++i) bits += (i * 7 % 5 < 2) ? '1' : '0';
+    IndexCache cache(testing::TempDir());
+    std::remove(cache.imagePath(bits).c_str());
+
+    bool cached;
+    auto built = cache.getOrBuild(bits, cached);
+    EXPECT_FALSE(cached);
+    auto read = cache.getOrBuild(bits, cached);
+    EXPECT_TRUE(cached);
+
+    for (size_t i = 0; i < bits.size(); i += 11) {
+        EXPECT_EQ(read->rank(1, i), built->rank(1, i));
+        EXPECT_EQ(read->access(i), built->access(i));
+    }
+    std::remove(cache.imagePath(bits).c_str());
+}
+
+/**
+ * Different inputs get different images
+ */
+TEST(IndexCache, KeyedByContent) {
+    std::string bits(1000, '0');
+    std::string other = bits;
+    other[999] = '1';
+    EXPECT_NE(IndexCache::hash(bits), IndexCache::hash(other));
+    EXPECT_NE(IndexCache::hash(bits), IndexCache::hash(bits + "0"));
+    EXPECT_EQ(IndexCache::hash(bits), IndexCache::hash(std::string(1000, '0')));
+
+    IndexCache cache(testing::TempDir());
+    bool cached;
+    cache.getOrBuild(bits, cached);
+    EXPECT_EQ(cache.load(other), nullptr);
+    std::remove(cache.imagePath(bits).c_str());
+}
+
+/**
+ * An image of other bits under the same name is rebuilt, not used
+ */
+TEST(IndexCache, ForeignImage) {
+    std::string bits(2000, '0');
+    std::string other(2000, '1');
+    IndexCache cache(testing::TempDir());
+    {
+        std::ofstream out(cache.imagePath(bits), std::ios::binary);
+        ASSERT_TRUE(Bitvector(other).writeImage(out));
+    }
+    EXPECT_EQ(cache.load(bits), nullptr);
+
+    bool cached;
+    auto bv = cache.getOrBuild(bits, cached);
+    EXPECT_FALSE(cached);
+    EXPECT_EQ(bv->rank(1, 1000), 0);
+    EXPECT_NE(cache.load(bits), nullptr);
+    std::remove(cache.imagePath(bits).c_str());
+}
+
+/**
+ * Bits that differ anywhere in a word, or that are not '0' and '1', do not match the image
+ */
+TEST(IndexCache, ContentCheck) {
+    std::string bits;
+    for (size_t i = 0; i < 1000; ++i) bits += (i * 13 % 7 < 3) ? '1' : '0';
+    IndexCache cache(testing::TempDir());
+    ASSERT_TRUE(cache.store(bits, Bitvector(bits)));
+    EXPECT_NE(cache.load(bits), nullptr);
+
+    for (size_t i : {0, 7, 8, 63, 64, 500, 995, 999}) {
+        std::string other = bits;
+        other[i] = other[i] == '1' ? '0' : '1';
+        ASSERT_TRUE(cache.store(other, Bitvector(bits)));
+        EXPECT_EQ(cache.load(other), nullptr);
+        std::remove(cache.imagePath(other).c_str());
+
+        // Anything but '1' counts as a zero bit
+        other[i] = 'x';
+        ASSERT_TRUE(cache.store(other, Bitvector(bits)));
+        EXPECT_EQ(cache.load(other) != nullptr, bits[i] == '0');
+        std::remove(cache.imagePath(other).c_str());
+    }
+    std::remove(cache.imagePath(bits).c_str());
+}
+
+/**
+ * A corrupt image is rebuilt instead of crashing
+ */
+TEST(IndexCache, CorruptImage) {
+    std::string bits;
+    for (size_t i = 0; i < 3000; ++i) bits += (i % 3 == 0) ? '1' : '0';
+    IndexCache cache(testing::TempDir());
+    ASSERT_TRUE(cache.store(bits, Bitvector(bits)));
+    {
+        // rankBlockSize is the third field of the image
+        std::fstream image(cache.imagePath(bits), std::ios::binary | std::ios::in | std::ios::out);
+        uint64_t rankBlockSize = 40;
+        image.seekp(16);
+        image.write(reinterpret_cast<const char*>(&rankBlockSize), sizeof(rankBlockSize));
+    }
+    bool cached;
+    auto bv = cache.getOrBuild(bits, cached);
+    EXPECT_FALSE(cached);
+    EXPECT_EQ(bv->rank(1, 3000 - 1), 1000);
+    std::remove(cache.imagePath(bits).c_str());
+}
+
+/**
+ * A missing directory only disables storing
+ */
+TEST(IndexCache, MissingDirectory) {
+    IndexCache cache(testing::TempDir() + "/does/not/exist");
+    bool cached;
+    auto bv = cache.getOrBuild("0110", cached);
+    EXPECT_FALSE(cached);
+    EXPECT_EQ(bv->rank(1, 3), 2);
+    EXPECT_FALSE(cache.store("0110", *bv));
+}
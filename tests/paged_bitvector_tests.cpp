@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "../src/paged_bitvector.hpp"
+
+/**
+ * Write bits into a paged bitvector file and open it with tiny chunks
+ */
+std::unique_ptr<PagedBitvector> openPaged(const std::string& bits, const std::string& name,
+                                          size_t chunkWords, size_t maxChunks) {
+    std::string path = testing::TempDir() + "/" + name;
+    std::istringstream input(bits + "\n");
+    EXPECT_TRUE(PagedBitvector::writeFile(input, path));
+    auto bv = PagedBitvector::open(path, chunkWords, maxChunks);
+    std::remove(path.c_str());  // The open file stays readable
+    return bv;
+}
+
+/**
+ * Compare access, rank and select with the string
+ */
+TEST(PagedBitvector, MatchesString) {
+    std::mt19937 rng(3);
+    for (size_t size : {1, 64, 512, 513, 70000, 140000}) {
+        std::string bits(size, '0');
+        for (auto& c : bits) c = rng() % 3 == 0 ? '1' : '0';
+        auto bv = openPaged(bits, "paged_" + std::to_string(size), 16, 3);
+        ASSERT_NE(bv, nullptr);
+        EXPECT_EQ(bv->getSize(), size);
+
+        size_t ones = 0;
+        for (size_t i = 0; i <= size; ++i) {
+            EXPECT_EQ(bv->rank(1, i), ones);
+            EXPECT_EQ(bv->rank(0, i), i - ones);
+            if (i == size) break;
+
+            EXPECT_EQ(bv->access(i), bits[i] == '1');
+            if (bits[i] == '1') {
+                ++ones;
+                EXPECT_EQ(bv->select(1, ones), i);
+            } else {
+                EXPECT_EQ(bv->select(0, i + 1 - ones), i);
+            }
+        }
+    }
+}
+
+/**
+ * A rank or select reads at most one chunk and the pool stays bounded
+ */
+TEST(PagedBitvector, ChunkReads) {
+    std::string bits;
+    for (size_t i = 0; i < 300000; ++i) bits += (i % 7 == 0 || i % 11 == 0) ? '1' : '0';
+    auto bv = openPaged(bits, "paged_reads", 64, 2);
+    ASSERT_NE(bv, nullptr);
+    size_t resident = bv->getSpace();
+
+    std::mt19937 rng(5);
+    for (size_t k = 0; k < 1000; ++k) {
+        size_t reads = bv->getChunkReads();
+        bv->rank(1, rng() % bits.size());
+        EXPECT_LE(bv->getChunkReads() - reads, 1);
+
+        reads = bv->getChunkReads();
+        bv->select(1, 1 + rng() % 60000);
+        EXPECT_LE(bv->getChunkReads() - reads, 1);
+    }
+    // Directories plus at most two chunks
+    EXPECT_LE(bv->getSpace(), resident + 2 * 64 * 64);
+
+    // Block starts are answered from the directories alone
+    size_t reads = bv->getChunkReads();
+    EXPECT_EQ(bv->rank(1, 512 * 100), std::count(bits.begin(), bits.begin() + 512 * 100, '1'));
+    EXPECT_EQ(bv->getChunkReads(), reads);
+}
+
+/**
+ * Missing and foreign files are rejected
+ */
+TEST(PagedBitvector, InvalidFile) {
+    EXPECT_EQ(PagedBitvector::open(testing::TempDir() + "/does_not_exist"), nullptr);
+
+    std::string path = testing::TempDir() + "/paged_foreign";
+    {
+        std::ofstream out(path);
+        out << "0110 is not a paged bitvector";
+    }
+    EXPECT_EQ(PagedBitvector::open(path), nullptr);
+    std::remove(path.c_str());
+}
+
+/**
+ * The size in the header must match the length of the file
+ */
+TEST(PagedBitvector, WrongSizeInHeader) {
+    std::string path = testing::TempDir() + "/paged_header";
+    std::istringstream input(std::string(1000, '1') + "\n");
+    ASSERT_TRUE(PagedBitvector::writeFile(input, path));
+
+    for (uint64_t size : {uint64_t(1) << 60, uint64_t(960), uint64_t(1025)}) {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(sizeof(uint64_t));
+        file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+        file.close();
+        EXPECT_EQ(PagedBitvector::open(path), nullptr);
+    }
+
+    // 1000 and 1024 bits both need 16 words
+    uint64_t size = 1024;
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(sizeof(uint64_t));
+    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    file.close();
+    EXPECT_NE(PagedBitvector::open(path), nullptr);
+    std::remove(path.c_str());
+}
+
+/**
+ * Reading a chunk that is gone throws instead of ending the process
+ */
+TEST(PagedBitvector, ReadFailureThrows) {
+    std::string path = testing::TempDir() + "/paged_truncated";
+    std::istringstream input(std::string(100000, '1') + "\n");
+    ASSERT_TRUE(PagedBitvector::writeFile(input, path));
+    auto bv = PagedBitvector::open(path, 64, 1);
+    ASSERT_NE(bv, nullptr);
+    EXPECT_EQ(bv->rank(1, 100), 100);
+
+    ASSERT_EQ(truncate(path.c_str(), 16), 0);
+    EXPECT_THROW(bv->rank(1, 90000), std::runtime_error);
+    EXPECT_THROW(bv->select(1, 90000), std::runtime_error);
+    // Block starts only need the directories
+    EXPECT_EQ(bv->rank(1, 512 * 100), 512 * 100);
+    std::remove(path.c_str());
+}
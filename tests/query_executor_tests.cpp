@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <sstream>
+
+#include "../src/query_executor.hpp"
+
+/**
+ * Build the expected output with a naive scan over the bit string
+ */
+std::string answerNaively(const std::string& bits, const std::string& commands) {
+    std::istringstream input(commands);
+    std::ostringstream output;
+    std::string command;
+    while (input >> command) {
+        size_t type, index;
+        if (command == "access") {
+            input >> index;
+            output << (bits[index] == '1') << "\n";
+        } else if (command == "rank") {
+            input >> type >> index;
+            output << std::count(bits.begin(), bits.begin() + index, type ? '1' : '0') << "\n";
+        } else {
+            input >> type >> index;
+            size_t pos = 0;
+            for (size_t seen = 0; pos < bits.size(); ++pos) {
+                if (bits[pos] == (type ? '1' : '0') && ++seen == index) break;
+            }
+            output << pos << "\n";
+        }
+    }
+    return output.str();
+}
+
+/**
+ * Small chunks force many chunks per worker, so results must be merged in order.
+ * The bitvector is large enough that select does not fall back to a scan.
+ */
+TEST(QueryExecutor, ResultsInOrder) {
+    std::string bits;
+    for (size_t i = 0; i < 3000; ++i) bits += (i * i % 7 < 3) ? '1' : '0';
+    size_t ones = std::count(bits.begin(), bits.end(), '1');
+    size_t zeros = bits.size() - ones;
+    Bitvector bv(bits);
+
+    std::string commands;
+    for (size_t i = 0; i < 500; ++i) {
+        commands += "access " + std::to_string(i * 7 % bits.size()) + "\n";
+        commands += "rank " + std::to_string(i % 2) + " " + std::to_string(i * 13 % bits.size()) + "\n";
+        commands += "select 1 " + std::to_string(i * 11 % ones + 1) + "\n";
+        commands += "select 0 " + std::to_string(i * 17 % zeros + 1) + "\n";
+    }
+    // Last line without a newline
+    commands += "select 0 " + std::to_string(zeros);
+
+    for (size_t threads : {1, 2, 4}) {
+        std::istringstream input(commands);
+        std::ostringstream output;
+        QueryExecutor executor(bv, threads, 64);
+        EXPECT_EQ(executor.run(input, output, 2001), 2001);
+        EXPECT_EQ(output.str(), answerNaively(bits, commands));
+    }
+}
+
+/**
+ * Only the given number of commands is answered, unknown ones give NaN
+ */
+TEST(QueryExecutor, CommandLimitAndUnknown) {
+    Bitvector bv("0110");
+    std::istringstream input("access 1\nflip 2\nrank 1 3\nselect 0 2\nrank 0 2");
+    std::ostringstream output;
+    QueryExecutor executor(bv, 2, 8);
+    EXPECT_EQ(executor.run(input, output, 3), 3);
+    EXPECT_EQ(output.str(), "1\nNaN\n2\n");
+
+    std::istringstream rest("select 0 2\nrank 0 2");
+    std::ostringstream restOutput;
+    EXPECT_EQ(executor.run(rest, restOutput, 10), 2);
+    EXPECT_EQ(restOutput.str(), "3\n1\n");
+}